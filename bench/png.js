@@ -0,0 +1,76 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+'use strict';
+
+/**
+ * Compares PNG encoders: OpenCV one against the parallel writer, with various filters and number of threads.
+ *
+ *   node bench/png.js [image] [iterations]
+ *
+ * The image is upscaled to twice its size, large images being the ones that matter here.
+ */
+
+/**
+ * Module dependencies.
+ */
+
+var ribs = require('..'),
+	async = require('async'),
+	path = require('path');
+
+/**
+ * Bench constants.
+ */
+
+var SRC_IMAGE = process.argv[2] || path.join(require('ribs-fixtures').path, 'lena.bmp'),
+	ITERATIONS = parseInt(process.argv[3], 10) || 10,
+	CASES = [
+		{ name: 'opencv', options: { opencv: true } },
+		{ name: 'none, 1 thread', options: { filter: 'none', threads: 1 } },
+		{ name: 'adaptive, 1 thread', options: { filter: 'adaptive', threads: 1 } },
+		{ name: 'none, all cores', options: { filter: 'none' } },
+		{ name: 'adaptive, all cores', options: { filter: 'adaptive' } }
+	];
+
+/**
+ * Bench.
+ */
+
+ribs(SRC_IMAGE).done(function(err, image) {
+	if (err) throw err;
+
+	image.resize(image.width * 2, image.height * 2, function(err, image) {
+		if (err) throw err;
+		bench(image);
+	});
+});
+
+function bench(image) {
+	console.log('%s: %dx%d, %d iterations', path.basename(SRC_IMAGE), image.width, image.height, ITERATIONS);
+
+	async.eachSeries(CASES, function(test, next) {
+		var size = 0,
+			start = process.hrtime();
+
+		async.timesSeries(ITERATIONS, function(i, next) {
+			image.encode('png', 0, test.options, function(err, data) {
+				if (data) size = data.length;
+				next(err);
+			});
+		}, function(err) {
+			if (err) return next(err);
+
+			var elapsed = process.hrtime(start),
+				ms = (elapsed[0] * 1e3 + elapsed[1] / 1e6) / ITERATIONS;
+
+			console.log('  %s: %s ms, %d bytes', (test.name + '                    ').slice(0, 20), ms.toFixed(1), size);
+			next();
+		});
+	}, function(err) {
+		if (err) throw err;
+	});
+}
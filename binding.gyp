@@ -9,6 +9,14 @@
 			'src/operation/encode.cc',
 			'src/operation/resize.cc',
 			'src/operation/crop.cc',
+			'src/operation/jpegcrop.cc',
+			'src/operation/levels.cc',
+			'src/operation/animate.cc',
+			'src/operation/sendfile.cc',
+			'src/gif.cc',
+			'src/jpeg.cc',
+			'src/palette.cc',
+			'src/png.cc',
 			'src/debug.cc',
 			'src/init.cc'
 		],
@@ -19,7 +27,9 @@
 		],
 
 		'libraries': [
-			'<!@(pkg-config opencv --libs)'
+			'<!@(pkg-config opencv --libs)',
+			'-ljpeg',
+			'-lz'
 		],
 
 		'cflags': [
@@ -60,6 +60,8 @@ Image.prototype.eachPixel = function(callback) {
  * current pixel.
  */
 Image.prototype.map = function(callback) {
+	this.source = null;
+	this.animation = null;
 	for (var i = 0, len = this.length; i < len; i++)
 		this[i] = callback(this[i], i, this) || this[i];
 };
@@ -70,6 +72,8 @@ Image.prototype.map = function(callback) {
  */
 Image.prototype.mapPixel = function(callback) {
 	var pixel = {};
+	this.source = null;
+	this.animation = null;
 	for (var i = 0, len = this.length, channels = this.channels; i < len; i += channels) {
 		pixel.r = this[i + 0];
 		pixel.g = this[i + 1];
@@ -0,0 +1,165 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+'use strict';
+
+/**
+ * A bounded, least recently used, cache.
+ *
+ * Entries are kept in a hash for constant time lookups and in a doubly linked list ordered by recency, so that
+ * evicting the least recently used entry is constant time too.
+ *
+ * The cache is bounded by its number of entries (`max`) and optionally by the sum of the lengths of its values
+ * (`maxLength`), the length of a value being given by the `length` function.
+ *
+ * @param {object|number} [options] - Options or maximum number of entries.
+ * @param {number} [options.max] - Maximum number of entries, defaults to `1000`.
+ * @param {number} [options.maxLength] - Maximum total length of values, unbounded by default.
+ * @param {function} [options.length] - Returns the length of a value, defaults to `1`.
+ * @constructor
+ */
+function LRU(options) {
+	// shortcut syntax
+	if (!(this instanceof LRU)) return new LRU(options);
+
+	if ('number' == typeof options)
+		options = { max: options };
+	options = options || {};
+
+	this.max = options.max || 1000;
+	this.maxLength = options.maxLength || Infinity;
+	this.lengthOf = options.length || function() { return 1; };
+
+	this.reset();
+}
+
+/**
+ * Retrieves a value and marks it as the most recently used.
+ *
+ * @param {string} key
+ * @return {*} - The value or `undefined`.
+ */
+LRU.prototype.get = function(key) {
+	var entry = this.entries[key];
+	if (!entry) return;
+
+	unlink(this, entry);
+	link(this, entry);
+
+	return entry.value;
+};
+
+/**
+ * Retrieves a value without marking it as used.
+ *
+ * @param {string} key
+ * @return {*} - The value or `undefined`.
+ */
+LRU.prototype.peek = function(key) {
+	var entry = this.entries[key];
+	if (entry) return entry.value;
+};
+
+/**
+ * Tells whether the cache has a value for a given key.
+ *
+ * @param {string} key
+ * @return {boolean}
+ */
+LRU.prototype.has = function(key) {
+	return (key in this.entries);
+};
+
+/**
+ * Stores a value as the most recently used, evicting the least recently used ones if needed.
+ * A value that would not fit in the cache on its own is not stored.
+ *
+ * @param {string} key
+ * @param {*} value
+ * @return {LRU}
+ */
+LRU.prototype.set = function(key, value) {
+	var length = this.lengthOf(value);
+
+	this.del(key);
+	if (length > this.maxLength) return this;
+
+	var entry = { key: key, value: value, length: length, prev: null, next: null };
+	this.entries[key] = entry;
+	this.length += length;
+	this.count++;
+	link(this, entry);
+
+	// evict until we are back in bounds
+	while (this.count > this.max || this.length > this.maxLength)
+		this.del(this.tail.key);
+
+	return this;
+};
+
+/**
+ * Removes a value.
+ *
+ * @param {string} key
+ * @return {LRU}
+ */
+LRU.prototype.del = function(key) {
+	var entry = this.entries[key];
+	if (!entry) return this;
+
+	unlink(this, entry);
+	delete this.entries[key];
+	this.length -= entry.length;
+	this.count--;
+
+	return this;
+};
+
+/**
+ * Removes all values.
+ *
+ * @return {LRU}
+ */
+LRU.prototype.reset = function() {
+	this.entries = Object.create(null);
+	this.head = this.tail = null;
+	this.length = 0;
+	this.count = 0;
+
+	return this;
+};
+
+/**
+ * Inserts an entry at the head of the list.
+ *
+ * @private
+ */
+function link(lru, entry) {
+	entry.prev = null;
+	entry.next = lru.head;
+	if (lru.head) lru.head.prev = entry;
+	lru.head = entry;
+	if (!lru.tail) lru.tail = entry;
+}
+
+/**
+ * Removes an entry from the list.
+ *
+ * @private
+ */
+function unlink(lru, entry) {
+	if (entry.prev) entry.prev.next = entry.next;
+	else lru.head = entry.next;
+	if (entry.next) entry.next.prev = entry.prev;
+	else lru.tail = entry.prev;
+	entry.prev = entry.next = null;
+}
+
+/**
+ * Export.
+ */
+
+module.exports = LRU;
@@ -8,10 +8,18 @@
 
 var ribs = require('./ribs'),
 	utils = ribs.utils,
+	Pipeline = ribs.Pipeline,
 	_ = require('lodash'),
+	async = require('async'),
+	fs = require('fs'),
 	path = require('path'),
+	util = require('util'),
+	Writable = require('stream').Writable,
 	express = require('express'),
-	FileStore = require('stores').FileStore;
+	LRU = require('./lru'),
+	Origin = require('./origin'),
+	Pyramid = require('./pyramid'),
+	Store = require('./store');
 
 /**
  * Fast check of param value.
@@ -28,10 +36,27 @@ var RE_PARAM = new RegExp('^(?:' +
 	// anchors and gravities
 	'[trbl]{1,2}|' +
 
+	// sharpen
+	's-?\\d+(?:\\.\\d+)?(?:_\\d+(?:\\.\\d+)?)?(?:_\\d+)?|' +
+
 	// image format
 	'jpg|png|bmp'  +
 ')$');
 
+/**
+ * Plan of urls that do not describe operations.
+ *
+ * @type {object}
+ */
+var SKIP = {};
+
+/**
+ * Open stores, by directory, so that middlewares sharing a directory share its store.
+ *
+ * @type {object}
+ */
+var stores = {};
+
 /**
  * Exports.
  */
@@ -47,16 +72,59 @@ var RE_PARAM = new RegExp('^(?:' +
 var operationNames = _(ribs.operations).keys().without('from', 'to').value();
 operationNames.push('format');
 
-module.exports = function(root) {
+/**
+ * Creates the middleware.
+ *
+ * Source images are read from `root` by default. When an `origin` is given, they are fetched from this upstream
+ * server instead and streamed directly to the decoder, `root` only holding processed images.
+ *
+ * @param {string} root - Root directory of source and processed images.
+ * @param {object} [options] - Options.
+ * @param {string} [options.origin] - Base URL of an upstream server to fetch source images from.
+ * @param {number} [options.maxSockets] - Maximum number of concurrent connections to the origin.
+ * @param {number} [options.cacheSize] - Maximum size in bytes of the origin source cache.
+ * @param {number} [options.timeout] - Maximum time in milliseconds to wait for the origin to respond, a `504` status
+ * being sent past it.
+ * @param {number} [options.deadline] - Maximum time in milliseconds to process an image, processing is aborted with a
+ * `503` status past it.
+ * @param {number} [options.plans] - Maximum number of compiled operation plans to cache, defaults to `1000`.
+ * @param {number} [options.rejectedPlans] - Maximum number of urls known not to describe valid operations to cache,
+ * defaults to `100`. Those are kept apart, so that junk urls never evict valid plans.
+ * @param {string} [options.pyramid] - Directory where to persist pyramids of local sources, so that resizes start from
+ * the nearest downscaled level instead of the full resolution source.
+ * @param {string} [options.store] - Directory of the processed images store, defaults to `.ribs` under `root`.
+ * Middlewares sharing a directory share the store created by the first one. Processed images are stored by operations
+ * and source version, so that urls describing the same operations share their processed images and a changed source
+ * is processed again. The version of a local source is its size and modification time, the one of an origin source is
+ * its `ETag`, revalidated on each request. Origin sources without `ETag` are not stored.
+ * @param {number} [options.storeSize] - Maximum size in bytes of the processed images store, defaults to 1GB.
+ */
+module.exports = function(root, options) {
+
+	// `(options)`
+	if ('object' == typeof root) {
+		options = root;
+		root = options.root;
+	}
+
+	options = options || {};
 
 	// root required
 	if (!root) throw new Error('ribs.middleware() root path required');
 
+	var origin = options.origin ? new Origin(options.origin, options) : null;
+	var pyramid = (options.pyramid && !origin) ? new Pyramid(options.pyramid) : null;
+
 	// TODO: handle cache at the store level
 	// TODO: refactor to know if there operations or if we should pass to next, this would avoid useless store access
 	// TODO: mute errors logs
 
-	var store = new FileStore({ root: root });
+	var storeDir = path.resolve(options.store || path.join(root, '.ribs'));
+	var store = stores[storeDir] || (stores[storeDir] = new Store(storeDir, { maxSize: options.storeSize }));
+
+	// compiled plans, by operations part of url, and rejections of urls that do not compile
+	var plans = new LRU(options.plans || 1000),
+		rejected = new LRU(options.rejectedPlans || 100);
 
 	return function(req, res, next) {
 		// early return if root url
@@ -65,108 +133,236 @@ module.exports = function(root) {
 		// only accepts GET method
 		if ('GET' != req.method) return;
 
+		// source file is always the last part of the url, operations are what comes before
+		var url = req.url,
+			slash = url.lastIndexOf('/'),
+			key = url.slice(0, slash),
+			source = url.slice(slash + 1),
+			plan = plans.get(key) || rejected.get(key);
+
 		// let's see if url describes some operations
-		// to know if we are in charge here
-		parseOperations(req, next, function(operations) {
-			// headers
-			res.on('header', function() {
-				// content type
-				// if already set, let it
-				// if no transcoding it's deduced from source file name
-				// if not from the destination format
-				var type = res.getHeader('Content-Type') ||
-					express.mime.lookup(operations.format);
-
-				res.header('Content-Type', type);
+		if (!plan) {
+			plan = compile(key);
+
+			if (SKIP === plan || plan instanceof Error) {
+				plan = (SKIP === plan ? SKIP : { message: plan.message, status: plan.status });
+				rejected.set(key, plan);
+			}
+			else
+				plans.set(key, plan);
+		}
+
+		// we are not in charge here, or url is known to be invalid.
+		// errors are created on each request, as next middlewares may alter them.
+		if (SKIP === plan) return next();
+		if (!plan.steps) return next(rejection(plan));
+
+		// headers
+		res.on('header', function() {
+			// content type
+			// if already set, let it
+			// if no transcoding it's deduced from source file name
+			// if not from the destination format
+			var type = res.getHeader('Content-Type') ||
+				express.mime.lookup(plan.format || path.extname(source));
+
+			res.header('Content-Type', type);
+		});
+
+		// local source, versioned by its size and modification time
+		if (!origin) {
+			var pathname = path.join(root, source);
+
+			return fs.stat(pathname, function(err, stat) {
+				var version = (err ? null : stat.size + ':' + stat.mtime.getTime()),
+					stored = (version ? plan.key + ':' + path.resolve(pathname) + ':' + version : null),
+					src = (pyramid ? { src: pathname, pyramid: pyramid } : pathname);
+
+				serve(res, stored, function(hit) {
+					if (!hit) run(req, plan, src, slot(res, source, stored), next);
+				});
 			});
+		}
+
+		// fetch source from origin and stream it to `from`, unless its version is already processed.
+		// the client may go away before the response comes in, upstream request is useless then.
+		var upstream,
+			aborted = false,
+			abort = function() {
+				aborted = true;
+				if (upstream) upstream.abort();
+			};
+
+		req.on('close', abort);
+
+		(function fetch(fresh) {
+			upstream = origin.fetch(source, { fresh: fresh }, function(err, src, version) {
+				if (aborted) return;
+				if (err) {
+					req.removeListener('close', abort);
+					return next(err);
+				}
+
+				var stored = (version ? plan.key + ':' + origin.resolve(source) + ':' + version : null);
 
-			// let's see if the store already contains
-			// the pre-processed image
-			store.get(req, res, next, function(req, slot, next) {
-				// set `slot` as destination stream
-				var format = _.find(operations, { operation: 'to' });
-				format.params.unshift(slot);
-
-				ribs(operations, function(err) {
-					if (err) {
-						err.status = 400;
-						next(err);
+				serve(res, stored, function(hit) {
+					if (aborted) return;
+
+					if (hit) {
+						req.removeListener('close', abort);
+						if (src && src.pipe) upstream.abort();
+						return;
 					}
+
+					// not modified, but not cached by the origin anymore
+					if (!src) return fetch(true);
+
+					req.removeListener('close', abort);
+					run(req, plan, src, slot(res, source, stored), next, upstream);
 				});
 			});
-		});
+		})(false);
 	};
 
 	/**
+	 * Serves a processed image from the store, if it is there.
+	 *
+	 * Hits are written straight from their segment to the client socket when possible, headers included, so that their
+	 * data never goes through JavaScript. Otherwise they are read then sent as usual.
 	 *
-	 * @param req
-	 * @param next
-	 * @param callback
-	 * @return {*}
+	 * @param {ServerResponse} res - Response.
+	 * @param {string|null} stored - Store key, nothing if the processed image is not stored.
+	 * @param {function} callback - Invoked with `(hit)`, `hit` being set if the response is sent.
 	 */
-	function parseOperations(req, next, callback) {
-		var url = req.url,
-			operations = [],
-			current;
-
-		// split arguments with the slash separator
-		var args = url.split('/');
-
-		// source file is always the last argument, store it and remove it
-		var pathname = path.join(root, args[args.length - 1]);
-		var from = { operation: 'from', params: [pathname] };
-		args.length--;
-
-		try {
-			// iterate through each argument
-			_.each(args, function(arg) {
-				// ignore empty arguments
-				if (!arg) return;
-
-				// operation is found
-				var operation = parseOperation(arg);
-				if (operation) {
-					current = {
-						operation: operation,
-						params: []
-					};
-					operations.push(current);
-					return;
-				}
+	function serve(res, stored, callback) {
+		if (!stored) return callback(false);
+
+		if (!writesDirectly(res)) {
+			return store.get(stored, function(err, data) {
+				if (!data) return callback(false);
+				res.end(data);
+				callback(true);
+			});
+		}
 
-				// param is found
-				var param = parseParam(arg);
-				if (param) {
-					if (current) {
-						current.params.push(param);
-						return;
-					}
-					else
-					// a know param has been parsed before any operation
-					// that means nothing...
-						throw null;
-				}
+		store.send(stored, res.socket, function(length) {
+			res.writeHead(200, { 'Content-Length': length });
+
+			// written by the store along with data, node must not write them again
+			res._headerSent = true;
+			return new Buffer(res._header, 'binary');
+		}, function(err, found) {
+			if (!found) return callback(false);
+
+			// headers are gone, the response can't be fixed anymore
+			if (err) res.socket.destroy();
+			else res.end();
+
+			callback(true);
+		});
+	}
+
+	/**
+	 * Creates the destination of a processed image, storing it if `stored` is given and sending it.
+	 *
+	 * @param {ServerResponse} res - Response.
+	 * @param {string} source - Source filename.
+	 * @param {string|null} stored - Store key.
+	 * @return {Slot}
+	 */
+	function slot(res, source, stored) {
+		return new Slot(source, function(data) {
+			if (stored) store.set(stored, data);
+			res.end(data);
+		});
+	}
 
-				if (current)
-					throw new Error('invalid parameter ' + arg + ' for operation ' + current.operation);
-				throw null;
+	/**
+	 * Runs a compiled plan from a given source to a given destination.
+	 * Processing is aborted if the client goes away or if the deadline is exceeded.
+	 *
+	 * @param {IncomingMessage} req - Request.
+	 * @param {object} plan - Compiled plan.
+	 * @param {*} src - Source image, as `from` accepts it.
+	 * @param {Writable} dst - Destination stream.
+	 * @param {function} next - Next middleware.
+	 * @param {ClientRequest} [upstream] - Origin request streaming the source, aborted along with processing.
+	 */
+	function run(req, plan, src, dst, next, upstream) {
+		var pipeline = new Pipeline(),
+			abort = function() {
+				pipeline.abort();
+				if (upstream) upstream.abort();
+			};
+
+		req.on('close', abort);
+		if (options.deadline) pipeline.deadline(options.deadline);
+
+		pipeline
+			.enqueue(plan.steps, { from: [src], to: [dst].concat(plan.toParams) })
+			.done(function(err) {
+				req.removeListener('close', abort);
+
+				if (err) {
+					err.status = err.status || 400;
+					next(err);
+				}
 			});
-		}
-		catch (err) {
-			// silent error, call next middleware
-			if (!err) return next();
+	}
+};
 
-			// arguments error
-			err.status = 400;
-			return next(err);
-		}
+/**
+ * Compiles the operations part of an url into a plan.
+ * Outcome is cached, invalid urls apart from valid ones, so the same url is never parsed twice.
+ *
+ * @param {string} key - Operations part of the url.
+ * @return {object|Error} - A plan, `SKIP` if the url does not describe operations or an error if it is invalid.
+ */
+function compile(key) {
+	var operations = [],
+		current;
+
+	try {
+		// iterate through each argument
+		_.each(key.split('/'), function(arg) {
+			// ignore empty arguments
+			if (!arg) return;
+
+			// operation is found
+			var operation = parseOperation(arg);
+			if (operation) {
+				current = {
+					operation: operation,
+					params: []
+				};
+				operations.push(current);
+				return;
+			}
+
+			// param is found
+			var param = parseParam(arg);
+			if (param) {
+				if (current) {
+					current.params.push(param);
+					return;
+				}
+				else
+				// a know param has been parsed before any operation
+				// that means nothing...
+					throw null;
+			}
+
+			if (current)
+				throw new Error('invalid parameter ' + arg + ' for operation ' + current.operation);
+			throw null;
+		});
 
-		// no operations, call next
+		// no operations
 		if (0 === operations.length)
-			return next();
+			return SKIP;
 
-		// prepend `from` operation
-		operations.unshift(from);
+		// prepend `from` operation, its source is given on each run
+		operations.unshift({ operation: 'from', params: null });
 
 		// ensure there is a `format` (`to`) operation
 		var format = _.find(operations, { operation: 'format' });
@@ -177,11 +373,95 @@ module.exports = function(root) {
 		else
 			format.operation = 'to';
 
-		// set image format for content type
-		operations.format = format.params[0] || path.extname(operations[0].params[0]);
+		return {
+			// canonical form of operations, whatever their aliases
+			key: operations.slice(1).map(function(step) {
+				return [step.operation].concat(step.params).join('/');
+			}).join('/'),
+			steps: Pipeline.compile(operations),
+			// image format for content type
+			format: format.params[0],
+			// destination is prepended on each run
+			toParams: format.params
+		};
+	}
+	catch (err) {
+		// silent error, call next middleware
+		if (!err) return SKIP;
 
-		callback(operations);
+		// arguments error
+		err.status = 400;
+		return err;
 	}
+}
+
+/**
+ * Closes the stores of all middlewares once their pending writes are done. Middlewares created afterwards open them
+ * again, those created before stop storing processed images.
+ *
+ * @param {function} [callback] - Invoked with `(err)`.
+ */
+module.exports.close = function(callback) {
+	var dirs = Object.keys(stores);
+
+	async.each(dirs, function(dir, next) {
+		var store = stores[dir];
+		delete stores[dir];
+		store.close(next);
+	}, callback || function() {});
+};
+
+/**
+ * Tells whether a response can be written straight to its socket, bypassing node: a plain TCP connection, with
+ * nothing written nor pending on it.
+ *
+ * @param {ServerResponse} res - Response.
+ * @return {boolean}
+ */
+function writesDirectly(res) {
+	var socket = res.socket,
+		handle = socket && socket._handle;
+
+	return !!(handle && handle.fd >= 0 && !socket.encrypted && socket._httpMessage === res && !res._header &&
+		!(res.output && res.output.length) && 0 === handle.writeQueueSize && 0 === socket._writableState.length);
+}
+
+/**
+ * Creates an error from a cached rejection.
+ *
+ * @param {object} cached - Message and status of the error.
+ * @return {Error}
+ */
+function rejection(cached) {
+	var err = new Error(cached.message);
+	err.status = cached.status;
+	return err;
+}
+
+/**
+ * Destination of a processed image, collecting it to store it and send it at once.
+ * Its `path` is the source one, so that `to` falls back to the source format.
+ *
+ * @param {string} source - Source filename.
+ * @param {function} callback - Invoked with the whole image data once written.
+ * @constructor
+ */
+function Slot(source, callback) {
+	Writable.call(this);
+
+	this.path = source;
+	this.chunks = [];
+
+	this.on('finish', function() {
+		callback(Buffer.concat(this.chunks));
+	});
+}
+
+util.inherits(Slot, Writable);
+
+Slot.prototype._write = function(chunk, encoding, callback) {
+	this.chunks.push(chunk);
+	callback();
 };
 
 function parseOperation(arg) {
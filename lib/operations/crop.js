@@ -12,6 +12,7 @@
 
 var Image = require('../image'),
 	Pipeline = require('../pipeline'),
+	to = require('./to'),
 	utils = require('../utils'),
 	check = utils.checkType,
 	checkInstance = utils.checkInstance;
@@ -65,7 +66,23 @@ function crop(params, image, next) {
 			return params;
 		}
 
-		image.crop(params.width, params.height, params.x, params.y, next);
+		// JPEG to JPEG crop only, crop DCT coefficients directly
+		if (isLossless(this, image)) {
+			cropLossless(this, params, image, next);
+			return params;
+		}
+
+		// pixels are about to change, original bytes are now stale
+		image.source = null;
+
+		// replay the crop on each frame
+		if (image.animation) {
+			image.animation.steps.push({
+				crop: true, x: params.x, y: params.y, width: params.width, height: params.height
+			});
+		}
+
+		cropPixels(this, params, image, next);
 
 		return params;
 	}
@@ -75,11 +92,110 @@ function crop(params, image, next) {
 	}
 }
 
+/**
+ * Tells whether a crop can be done losslessly on the original JPEG bytes.
+ * This is the case when pixels are not decoded yet, the crop is the only operation touching them and the output is a
+ * plain JPEG: written as is, without changing quality nor progressive mode, nor searching a byte budget.
+ *
+ * @private
+ * @param {Pipeline} pipeline - Pipeline invoking the operation, if any.
+ * @param {Image} image - Image to crop.
+ * @return {boolean}
+ */
+function isLossless(pipeline, image) {
+	if (!(pipeline instanceof Pipeline)) return false;
+	if (!image.source || !image.pending || 'jpg' != image.originalFormat) return false;
+
+	var operations = pipeline.pixelOperations();
+	if (1 != operations.length || 'crop' != operations[0]) return false;
+
+	var params = pipeline.paramsOf('to');
+	if (null == params || 'jpg' != to.format(params, image)) return false;
+
+	if (Array.isArray(params))
+		params = utils.toParams(params, ['dst', 'format', 'quality', 'progressive', 'maxBytes']);
+
+	return !params.quality && !params.progressive && !params.maxBytes;
+}
+
+/**
+ * Crops original JPEG bytes without decoding them.
+ * The region origin is snapped to the nearest MCU boundary, its size is preserved. The cropped image is read back
+ * from the new bytes header only, so that `to` writes them as is.
+ *
+ * @private
+ * @param {Pipeline} pipeline - Pipeline invoking the operation.
+ * @param {object} params - Constrained params.
+ * @param {Image} image - Image to crop.
+ * @param {function} next - Next function in the pipeline.
+ */
+function cropLossless(pipeline, params, image, next) {
+	var block = Image.jpegBlockSize(image.source);
+
+	// unknown layout, fallback to a classic crop
+	if (!block) {
+		image.source = null;
+		return cropPixels(pipeline, params, image, next);
+	}
+
+	params.x = snap(params.x, params.width, image.width, block.width);
+	params.y = snap(params.y, params.height, image.height, block.height);
+
+	Pipeline.track(pipeline, Image.cropJpeg(image.source, params.width, params.height, params.x, params.y,
+		function(err, data) {
+			// cancelled, do not fallback
+			if (pipeline.aborted) return next(err, image);
+
+			var cropped = (err ? null : Image.probe(data));
+
+			if (!cropped) {
+				image.source = null;
+				return cropPixels(pipeline, params, image, next);
+			}
+
+			cropped.source = data;
+			cropped.pending = data;
+			cropped.animation = null;
+			next(null, cropped);
+		}
+	));
+}
+
+/**
+ * Crops decoded pixels, decoding them first if needed.
+ *
+ * @private
+ * @param {Pipeline} pipeline - Pipeline invoking the operation.
+ * @param {object} params - Constrained params.
+ * @param {Image} image - Image to crop.
+ * @param {function} next - Next function in the pipeline.
+ */
+function cropPixels(pipeline, params, image, next) {
+	Pipeline.load(pipeline, image, function(err, image) {
+		if (err) return next(err, image);
+		Pipeline.track(pipeline, image.crop(params.width, params.height, params.x, params.y, next));
+	});
+}
+
+/**
+ * Snaps a coordinate to the nearest multiple of `block` keeping the region inside the image.
+ *
+ * @private
+ */
+function snap(origin, size, max, block) {
+	var snapped = Math.round(origin / block) * block;
+	if (snapped + size > max) snapped -= block;
+	return Math.max(0, snapped);
+}
+
 /**
  * Register operation.
  */
 
 Pipeline.add('crop', crop);
+crop.keepsSource = true;
+crop.keepsAnimation = true;
+crop.loadsPixels = true;
 
 /**
  * Export.
@@ -10,18 +10,26 @@
  * Module dependencies.
  */
 
-var fs = require('fs'),
+var _ = require('lodash'),
+	fs = require('fs'),
 	Image = require('../image'),
 	Pipeline = require('../pipeline'),
+	Pyramid = require('../pyramid'),
+	resize = require('./resize'),
 	utils = require('../utils'),
 	check = utils.checkType;
 
 /**
  *
  * @param {object|string|Buffer|Readable} src - Source image.
+ * @param {string} src.src - Filename of the source image, when backed by a pyramid.
+ * @param {Pyramid} src.pyramid - Pyramid of the source image. When the first operation is a resize, the smallest
+ * level still larger than the target size is decoded instead of the source.
  * @param {function} next - Next function in the pipeline.
  */
 function from(src, next) {
+	var pipeline = this;
+
 	check('next', next, false, 'function');
 
 	try {
@@ -31,6 +39,12 @@ function from(src, next) {
 		if (Array.isArray(src))
 			src = src[0];
 
+		// src is a path backed by a pyramid
+		if (src && 'string' == typeof src.src && src.pyramid instanceof Pyramid) {
+			fromPyramid(this, src.src, src.pyramid, next);
+			return src;
+		}
+
 		// src is a path, create a readable stream
 		if ('string' == typeof src) {
 			src = fs.createReadStream(src);
@@ -45,7 +59,7 @@ function from(src, next) {
 				if (0 === buffers.length)
 					return next(new Error('empty file: ' + src.path), null);
 
-				Image.decode(Buffer.concat(buffers), next);
+				decode(pipeline, Buffer.concat(buffers), next);
 			});
 			src.on('error', function(err) {
 				// indirection for curry
@@ -54,7 +68,7 @@ function from(src, next) {
 		}
 		// src is a buffer, decode it directly
 		else if (Buffer.isBuffer(src)) {
-			Image.decode(src, next);
+			decode(pipeline, src, next);
 		}
 		else
 			throw new Error('invalid source image');
@@ -67,11 +81,143 @@ function from(src, next) {
 	}
 }
 
+/**
+ * Decodes the pyramid level the best suited to the following resize.
+ *
+ * The first time a source is requested, it is decoded and its pyramid is built aside from the decoded pixels. Next
+ * times, the resize target is resolved against the source size, the matching level is decoded and the resize is
+ * rebound to the resolved target, so that relative sizes are still relative to the source.
+ *
+ * @private
+ * @param {Pipeline} pipeline - Pipeline invoking the operation.
+ * @param {string} filename - Source image filename.
+ * @param {Pyramid} pyramid - Pyramid store.
+ * @param {function} next - Next function in the pipeline.
+ */
+function fromPyramid(pipeline, filename, pyramid, next) {
+	var target = resizeTarget(pipeline);
+
+	// no resize ahead, levels are useless
+	if (!target) return from.call(pipeline, filename, next);
+
+	pyramid.open(filename, function(err, header, stat) {
+		if (err) return next(err, null);
+
+		// first time, decode the source and build its pyramid aside, from the same pixels
+		if (!header) {
+			return fs.readFile(filename, function(err, buffer) {
+				if (err) return next(err, null);
+
+				decodePixels(pipeline, buffer, function(err, image) {
+					if (image) pyramid.build(filename, stat, image);
+					next(err, image);
+				});
+			});
+		}
+
+		var params, level;
+
+		try {
+			params = target(header.width, header.height);
+			level = Pyramid.select(header, params.width, params.height);
+		}
+		catch (err) {
+			// let resize report invalid params
+		}
+
+		// the source itself is the best fit
+		if (!level) {
+			pyramid.close(header);
+			return from.call(pipeline, filename, next);
+		}
+
+		pyramid.read(header, level, function(err, buffer) {
+			pyramid.close(header);
+
+			// unreadable level, fallback to the source
+			if (err) return from.call(pipeline, filename, next);
+
+			pipeline.rebind('resize', params);
+			decode(pipeline, buffer, next);
+		});
+	});
+}
+
+/**
+ * Returns a function resolving the params of the resize following `from` against a given source size.
+ *
+ * @private
+ * @param {Pipeline} pipeline - Pipeline invoking the operation.
+ * @return {function|undefined} - Nothing if the first pixel operation is not a resize.
+ */
+function resizeTarget(pipeline) {
+	if (!(pipeline instanceof Pipeline) || 'resize' != pipeline.pixelOperations()[0]) return;
+
+	var params = pipeline.paramsOf('resize');
+	if (null == params) return;
+
+	return function(width, height) {
+		var target = _.clone(resize.normalize(params));
+		Pipeline.hook('resize', 'constraints')(target, { width: width, height: height });
+		return target;
+	};
+}
+
+/**
+ * Decodes a source image, keeping its original compressed bytes aside.
+ * Those are streamed as is by `to` if the image ends up being untouched.
+ *
+ * If the pipeline writes the image, pixels may not be needed at all: only the header is read, giving dimensions to
+ * following operations. Pixels are then decoded by the first operation touching them (see `Pipeline.load`), and
+ * `image.pending` holds the bytes to decode until then.
+ *
+ * Only the first frame of a GIF is decoded. If it is animated, its bytes are kept aside as well in `image.animation`,
+ * along with the transformations applied to the first frame, so that `to` can replay them on each frame.
+ *
+ * @private
+ * @param {Pipeline} [pipeline] - Pipeline invoking the operation.
+ * @param {Buffer} buffer - Compressed image.
+ * @param {function} next - Next function in the pipeline.
+ */
+function decode(pipeline, buffer, next) {
+	var image = (pipeline instanceof Pipeline && undefined !== pipeline.paramsOf('to') ? Image.probe(buffer) : null);
+
+	// header is enough for now
+	if (image) {
+		image.source = buffer;
+		image.pending = buffer;
+		image.animation = null;
+		return setImmediate(next, null, image);
+	}
+
+	decodePixels(pipeline, buffer, next);
+}
+
+/**
+ * Decodes pixels of a source image right away.
+ *
+ * @private
+ * @param {Pipeline} [pipeline] - Pipeline invoking the operation.
+ * @param {Buffer} buffer - Compressed image.
+ * @param {function} next - Next function in the pipeline.
+ */
+function decodePixels(pipeline, buffer, next) {
+	Pipeline.track(pipeline, Image.decode(buffer, function(err, image) {
+		if (image) {
+			image.source = buffer;
+			image.animation = (image.animated ? { source: buffer, steps: [] } : null);
+		}
+		next(err, image);
+	}));
+}
+
 /**
  * Register operation.
  */
 
 Pipeline.add('from', from);
+from.keepsSource = true;
+from.keepsAnimation = true;
 
 /**
  * Export.
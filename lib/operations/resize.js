@@ -10,7 +10,8 @@
  * Module dependencies.
  */
 
-var Image = require('../image'),
+var _ = require('lodash'),
+	Image = require('../image'),
 	Pipeline = require('../pipeline'),
 	utils = require('../utils'),
 	check = utils.checkType,
@@ -32,24 +33,23 @@ function resize(params, image, next) {
 		// early call back if params is null
 		if (null == params) return next(null, image);
 
-		// if params is a number or a string, it is assigned to width
-		if ('string' == typeof params || 'number' == typeof params)
-			params = { width: params };
-
-		// array to named arguments
-		else if (Array.isArray(params))
-			params = utils.toParams(params, ['width', 'height']);
+		params = normalize(params);
 
 		check('width', params.width, true, 'number', 'string');
 		check('height', params.height, true, 'number', 'string');
+		check('sharpen', params.sharpen, true, 'string', 'object');
 		check('image', image, false, 'object');
 		checkInstance('image', image, Image);
 
 		// invoke the constraints hook
 		Pipeline.hook('resize', 'constraints')(params, image);
 
-		// do nothing when specified size is the same as original one
-		if (image.width == params.width && image.height == params.height) {
+		// normalize sharpen specification
+		if (null != params.sharpen)
+			params.sharpen = utils.parseSharpen(params.sharpen);
+
+		// do nothing when specified size is the same as original one and there is nothing to sharpen
+		if (image.width == params.width && image.height == params.height && !hasSharpen(params)) {
 			next(null, image);
 			return params;
 		}
@@ -60,7 +60,31 @@ function resize(params, image, next) {
 			return params;
 		}
 
-		image.resize(params.width, params.height, next);
+		// pixels are about to change, original bytes are now stale
+		image.source = null;
+
+		// replay the resize on each frame, sharpening is not available there
+		if (image.animation) {
+			if (hasSharpen(params))
+				image.animation = null;
+			else
+				image.animation.steps.push({ width: params.width, height: params.height });
+		}
+
+		var pipeline = this;
+
+		Pipeline.load(pipeline, image, function(err, image) {
+			if (err) return next(err, image);
+
+			// sharpening is fused with resizing, in the same native pass
+			if (hasSharpen(params)) {
+				var s = params.sharpen;
+				Pipeline.track(pipeline, image.resize(params.width, params.height, s.amount / 100, s.radius, s.threshold,
+					next));
+			}
+			else
+				Pipeline.track(pipeline, image.resize(params.width, params.height, next));
+		});
 
 		return params;
 	}
@@ -70,11 +94,48 @@ function resize(params, image, next) {
 	}
 }
 
+/**
+ * Converts scalar and array params to named params.
+ *
+ * @param {object|[]|string|number} params
+ * @return {object}
+ */
+function normalize(params) {
+	// if params is a number or a string, it is assigned to width
+	if ('string' == typeof params || 'number' == typeof params)
+		return { width: params };
+
+	// array to named arguments
+	// a sharpen specification can be anywhere after the size
+	if (Array.isArray(params)) {
+		var sharpen = _.find(params, utils.isSharpen);
+		params = utils.toParams(_.reject(params, utils.isSharpen), ['width', 'height']);
+		params.sharpen = sharpen;
+	}
+
+	return params;
+}
+
+/**
+ * Tells whether resize params hold a meaningful sharpen specification.
+ *
+ * @private
+ * @param {object} params
+ * @returns {boolean}
+ */
+function hasSharpen(params) {
+	return (null != params.sharpen && 0 !== params.sharpen.amount);
+}
+
 /**
  * Register operation.
  */
 
 Pipeline.add('resize', resize);
+resize.keepsSource = true;
+resize.keepsAnimation = true;
+resize.loadsPixels = true;
+resize.normalize = normalize;
 
 /**
  * Export.
@@ -25,7 +25,19 @@ var fs = require('fs'),
  * @param {string} params.format - Output format.
  * @param {string} params.quality - Quality (1 - 100) of the destination image, only applies to JPEG.
  * @param {boolean} params.progressive - Either the destination image is progressive or not, only applies to JPEG.
- * @param {Image} image - Image instance.
+ * @param {number} params.maxBytes - Maximum size of the destination image (1 - 4294967295), only applies to JPEG. The
+ * best quality (up to `quality`) fitting in this budget is searched natively, the output being baseline so it can't
+ * be combined with `progressive`. Once encoded, `params.encoded` holds the chosen `quality` and the number of
+ * `trials`.
+ * @param {string} params.filter - Row filter (`none`, `sub`, `up`, `avg`, `paeth` or `adaptive`), only applies to
+ * PNG. Defaults to `adaptive`, picking the best filter for each row, or `none` for palette images.
+ * @param {number} params.colors - Number of colors (2 - 256) of the destination image, only applies to PNG and GIF.
+ * The image is quantized natively and written as a palette image. GIF defaults to 256 colors.
+ * @param {boolean} params.dither - Either quantized colors are dithered or not, only applies when `colors` is set.
+ * @param {Image} image - Image instance. If it holds its original bytes (`image.source`) and neither format, quality
+ * nor progressive are changed, those are written as is. If it is animated (`image.animation`) and the output is a
+ * GIF, every frame is transformed the same way and written, otherwise only the first one is. Pixels of a lazily
+ * decoded image are only decoded if it has to be encoded.
  * @param {function} next - Next function in the pipeline.
  */
 function to(params, image, next) {
@@ -38,17 +50,23 @@ function to(params, image, next) {
 		check('format', params.format, true, 'string');
 		check('quality', params.quality, true, 'number');
 		check('progressive', params.progressive, true, 'boolean');
+		check('maxBytes', params.maxBytes, true, 'number');
+		check('filter', params.filter, true, 'string');
+		check('colors', params.colors, true, 'number');
+		check('dither', params.dither, true, 'boolean');
 		check('image', image, false, 'object');
 		checkInstance('image', image, Image);
 
 		// array to named arguments
 		if (Array.isArray(params))
-			params = utils.toParams(params, ['dst', 'format', 'quality', 'progressive']);
+			params = utils.toParams(params, ['dst', 'format', 'quality', 'progressive', 'maxBytes']);
 
 		// arguments splitting
 		var dst = params.dst || params;
 		var quality = params.quality || 0;
 		var progressive = params.progressive || false;
+		var maxBytes = params.maxBytes || 0;
+		var colors = params.colors || 0;
 		var format;
 
 		// if dst is a path, create a writable stream
@@ -66,31 +84,54 @@ function to(params, image, next) {
 		// final format
 		format = params.format || format || image.originalFormat;
 
-		// encode the image
-		image.encode(format, quality, function(err, data) {
-			if (err) return next(err, image);
+		if (maxBytes && 'jpg' != format)
+			throw new Error('invalid maxBytes: only applies to jpg');
+		if (maxBytes && (maxBytes < 1 || maxBytes > 0xffffffff || maxBytes % 1))
+			throw new Error('invalid maxBytes: must be an integer between 1 and 4294967295');
+		if (maxBytes && progressive)
+			throw new Error('invalid progressive: does not apply with maxBytes');
+		if (colors && 'png' != format && 'gif' != format)
+			throw new Error('invalid colors: only applies to png and gif');
+		if (colors && (colors < 2 || colors > 256))
+			throw new Error('invalid colors: must be between 2 and 256');
+
+		// nothing changed since the image has been decoded, send original bytes untouched.
+		// this avoids encoding and generational quality loss.
+		if (image.source && format == image.originalFormat && !quality && !progressive && !colors &&
+			(!maxBytes || image.source.length <= maxBytes)) {
+			write(dst, image.source, image, next);
+			return params;
+		}
+
+		// transcode frames of an animation one by one, sharing a single palette
+		if (image.animation && 'gif' == format) {
+			var animation = image.animation;
 
-			// dst is a stream, write to it
-			if (utils.isWritableStream(dst)) {
-				if (process.stdout !== dst)
-					dst.end(data);
-				else
-					dst.write(data);
+			Pipeline.track(this, Image.animate(animation.source, animation.steps,
+				{ colors: colors || 256, dither: params.dither }, function(err, data) {
+					if (err) return next(err, image);
+					write(dst, data, image, next);
+				}
+			));
 
-				dst.on('finish', function() {
-					next(null, image);
-				});
-				dst.on('error', function(err) {
-					next(err, image);
-				});
+			return params;
+		}
+
+		// encode the image, within a byte budget or to a palette if any
+		var options = { maxBytes: maxBytes, filter: params.filter, colors: colors, dither: params.dither },
+			pipeline = this;
 
-				return;
-			}
+		Pipeline.load(pipeline, image, function(err, image) {
+			if (err) return next(err, image);
 
-			// dst is a buffer, copy data
-			data.copy(dst);
+			Pipeline.track(pipeline, image.encode(format, quality, options, function(err, data) {
+				if (err) return next(err, image);
 
-			next(null, image);
+				if (maxBytes)
+					params.encoded = { quality: data.quality, trials: data.trials };
+
+				write(dst, data, image, next);
+			}));
 		});
 
 		return params;
@@ -101,11 +142,68 @@ function to(params, image, next) {
 	}
 }
 
+/**
+ * Resolves the output format `to` would use for given params, without touching the destination.
+ *
+ * @param {string|object|array} params - `to` parameters.
+ * @param {Image} image - Image instance.
+ * @return {string} - Output format.
+ */
+to.format = function(params, image) {
+	if (Array.isArray(params))
+		params = utils.toParams(params, ['dst', 'format']);
+
+	var dst = (params && params.dst) || params,
+		format;
+
+	if ('string' == typeof dst)
+		format = path.extname(dst).slice(1);
+	else if (dst && 'string' == typeof dst.path)
+		format = path.extname(dst.path).slice(1);
+
+	return (params && params.format) || format || image.originalFormat;
+};
+
+/**
+ * Writes encoded data to the destination.
+ *
+ * @private
+ * @param {Writable|Buffer} dst - Destination.
+ * @param {Buffer} data - Encoded image.
+ * @param {Image} image - Image instance.
+ * @param {function} next - Next function in the pipeline.
+ */
+function write(dst, data, image, next) {
+	// dst is a stream, write to it
+	if (utils.isWritableStream(dst)) {
+		if (process.stdout !== dst)
+			dst.end(data);
+		else
+			dst.write(data);
+
+		dst.on('finish', function() {
+			next(null, image);
+		});
+		dst.on('error', function(err) {
+			next(err, image);
+		});
+
+		return;
+	}
+
+	// dst is a buffer, copy data
+	data.copy(dst);
+
+	next(null, image);
+}
+
 /**
  * Register operation.
  */
 
 Pipeline.add('to', to);
+to.keepsSource = true;
+to.loadsPixels = true;
 
 /**
  * Export.
@@ -0,0 +1,367 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+'use strict';
+
+/**
+ * Module dependencies.
+ */
+
+var http = require('http'),
+	https = require('https'),
+	url = require('url'),
+	util = require('util'),
+	Transform = require('stream').Transform,
+	LRU = require('./lru');
+
+/**
+ * Time in milliseconds after which an idle upstream connection is closed.
+ *
+ * @type {number}
+ */
+var IDLE_TIMEOUT = 15000;
+
+/**
+ * An `Origin` fetches source images from an upstream HTTP server.
+ *
+ * Connections are kept alive and pooled by a dedicated agent, which also bounds the number of concurrent fetches.
+ * Fetched responses are streamed as is to the caller, so they can be decoded without being staged on disk. A fetch
+ * whose response does not start within `timeout` fails with a `504 Gateway Timeout`, other upstream failures with a
+ * `502 Bad Gateway`.
+ *
+ * Sources carrying an `ETag` are kept in a bounded memory cache keyed by their origin URL and `ETag`. Subsequent
+ * fetches of the same URL are revalidated with a conditional request, a `304 Not Modified` being served from the
+ * cache. The last `ETag` of more URLs than the cache holds is remembered too, so that the version of a source is
+ * known without transferring it again.
+ *
+ * @param {string} base - Base URL of the upstream server.
+ * @param {object} [options] - Options.
+ * @param {number} [options.maxSockets] - Maximum number of concurrent connections, defaults to `16`.
+ * @param {number} [options.cacheSize] - Maximum size of the source cache in bytes, defaults to 64MB. `0` disables it.
+ * @param {number} [options.timeout] - Maximum time in milliseconds to wait for a response, defaults to `10000`. `0`
+ * disables it.
+ * @constructor
+ */
+function Origin(base, options) {
+	// shortcut syntax
+	if (!(this instanceof Origin)) return new Origin(base, options);
+
+	options = options || {};
+
+	this.base = url.parse(base);
+	if (!/^https?:$/.test(this.base.protocol))
+		throw new Error('invalid origin: ' + base);
+
+	// ensure base path ends with a slash so that resolving keeps it
+	if ('/' != this.base.pathname[this.base.pathname.length - 1])
+		this.base.pathname += '/';
+
+	this.transport = ('https:' == this.base.protocol ? https : http);
+	this.agent = new this.transport.Agent({
+		keepAlive: true,
+		maxSockets: options.maxSockets || 16
+	});
+
+	// agents prior to node 0.11 ignore `keepAlive`
+	if (!this.agent.keepAlive) keepAlive(this.agent);
+
+	this.timeout = (null == options.timeout ? 10000 : options.timeout);
+
+	var cacheSize = (null == options.cacheSize ? 64 * 1024 * 1024 : options.cacheSize);
+	if (cacheSize > 0) {
+		this.cache = new LRU({
+			maxLength: cacheSize,
+			length: function(source) { return source.data.length; }
+		});
+	}
+
+	// last known ETag, by URL
+	this.versions = new LRU(10000);
+}
+
+/**
+ * Fetches a source image.
+ *
+ * The callback is invoked with either a readable stream of the response or a buffer when the source is served from
+ * the cache. Both can be passed directly to the `from` operation. Paths resolving outside of the base URL, once
+ * decoded, are rejected.
+ *
+ * The `ETag` of the source is given along, if any. When the source is known not to be modified but is not cached
+ * anymore, there is no source: fetch it again with `options.fresh` if it is needed.
+ *
+ * @param {string} pathname - Path of the source image, relative to the origin base URL.
+ * @param {object} [options] - Options.
+ * @param {boolean} [options.fresh] - Requests the source unconditionally.
+ * @param {function} callback - Invoked with `(err, src, version)`.
+ * @return {ClientRequest|null} - Upstream request, to abort it if the source is not needed anymore.
+ */
+Origin.prototype.fetch = function(pathname, options, callback) {
+	// `(pathname, callback)`
+	if ('function' == typeof options) {
+		callback = options;
+		options = {};
+	}
+
+	var fresh = options.fresh,
+		base = url.format(this.base),
+		relative = pathname.replace(/^\/+/, ''),
+		href = this.resolve(pathname);
+
+	// upstream servers decode paths, so check the decoded one too
+	if (!this.contains(href) || !this.contains(decoded(base, relative))) {
+		process.nextTick(callback.bind(null, originError(href, 404), null));
+		return null;
+	}
+
+	var cached = this.cache && this.cache.get(href),
+		known = (cached ? cached.etag : this.versions.get(href));
+
+	options = url.parse(href);
+	options.agent = this.agent;
+	options.headers = {};
+
+	// revalidate what we already have, or at least know of
+	if (known && !fresh)
+		options.headers['If-None-Match'] = known;
+
+	var timedOut = false,
+		timer = null;
+
+	var req = this.transport.get(options, function(res) {
+		clearTimeout(timer);
+		if (timedOut) return res.resume();
+
+		// not modified, serve our copy if any
+		if (304 == res.statusCode && known && !fresh) {
+			res.resume();
+			return callback(null, cached ? cached.data : null, known);
+		}
+
+		if (200 != res.statusCode) {
+			res.resume();
+			return callback(originError(href, res.statusCode), null);
+		}
+
+		var etag = res.headers.etag,
+			versions = this.versions;
+
+		// a version is only known once its source has been received whole
+		versions.del(href);
+
+		// nothing to revalidate with, stream it directly
+		if (!etag || !this.cache) {
+			if (cached) this.cache.del(href);
+			if (etag) {
+				res.on('end', function() {
+					if (res.complete) versions.set(href, etag);
+				});
+			}
+			return callback(null, res, etag);
+		}
+
+		// stream it and keep a copy for later revalidations, once it is known to be whole
+		var tee = new Tee(res, function(data) {
+			versions.set(href, etag);
+			this.cache.set(href, { etag: etag, data: data });
+		}.bind(this));
+		res.on('error', function(err) {
+			err.status = err.status || 502;
+			tee.emit('error', err);
+		});
+
+		callback(null, res.pipe(tee), etag);
+	}.bind(this));
+
+	req.on('error', function(err) {
+		clearTimeout(timer);
+		if (timedOut) return;
+
+		err.status = 502;
+		callback(err, null);
+	});
+
+	// give up on an unresponsive upstream, the response body is then bounded by the processing deadline
+	if (this.timeout > 0) {
+		timer = setTimeout(function() {
+			timedOut = true;
+			req.abort();
+
+			var err = new Error('origin error: timeout for ' + href);
+			err.status = 504;
+			callback(err, null);
+		}, this.timeout);
+	}
+
+	return req;
+};
+
+/**
+ * Resolves the URL of a source image.
+ *
+ * @param {string} pathname - Path of the source image, relative to the origin base URL.
+ * @return {string}
+ */
+Origin.prototype.resolve = function(pathname) {
+	return url.resolve(url.format(this.base), pathname.replace(/^\/+/, ''));
+};
+
+/**
+ * Tells whether an URL is under the base URL.
+ *
+ * @param {string} href - URL.
+ * @return {boolean}
+ */
+Origin.prototype.contains = function(href) {
+	return (null != href && 0 === href.indexOf(url.format(this.base)));
+};
+
+/**
+ * Resolves a percent-decoded path against a base URL.
+ *
+ * @private
+ * @return {string|null} - Nothing if the path can't be decoded.
+ */
+function decoded(base, pathname) {
+	try {
+		return url.resolve(base, decodeURIComponent(pathname));
+	}
+	catch (err) {
+		return null;
+	}
+}
+
+/**
+ * Keeps the connections of an agent open once idle, so that later requests reuse them.
+ * Agents prior to node 0.11 close a connection as soon as no request is pending on it. Idle connections are
+ * unreferenced, so that they don't keep the process alive, and closed after `IDLE_TIMEOUT`.
+ *
+ * @private
+ * @param {Agent} agent - Agent.
+ */
+function keepAlive(agent) {
+	var idle = {};
+
+	function name(host, port, localAddress) {
+		return host + ':' + port + (localAddress ? ':' + localAddress : '');
+	}
+
+	function take(socket) {
+		var sockets = idle[socket._idleName],
+			index = (sockets ? sockets.indexOf(socket) : -1);
+
+		if (-1 != index) sockets.splice(index, 1);
+		socket.removeListener('error', socket._idleListener);
+		socket.removeListener('close', socket._idleListener);
+		socket.removeListener('timeout', socket._idleListener);
+		socket.setTimeout(0);
+		if (socket.ref) socket.ref();
+	}
+
+	// replaces the default listener, which destroys sockets nobody waits for
+	agent.removeAllListeners('free');
+	agent.on('free', function(socket, host, port, localAddress) {
+		var key = name(host, port, localAddress),
+			pending = agent.requests[key];
+
+		if (pending && pending.length) {
+			pending.shift().onSocket(socket);
+			if (!pending.length) delete agent.requests[key];
+			return;
+		}
+
+		// park it, dropping it on error, close or timeout
+		socket._idleName = key;
+		socket._idleListener = socket._idleListener || function() {
+			take(socket);
+			socket.destroy();
+		};
+		socket.on('error', socket._idleListener);
+		socket.on('close', socket._idleListener);
+		socket.on('timeout', socket._idleListener);
+		socket.setTimeout(IDLE_TIMEOUT);
+		if (socket.unref) socket.unref();
+
+		(idle[key] = idle[key] || []).push(socket);
+	});
+
+	var addRequest = agent.addRequest;
+	agent.addRequest = function(req, host, port, localAddress) {
+		var sockets = idle[name(host, port, localAddress)];
+
+		// most recently parked first, the least likely to have been closed by the upstream server
+		while (sockets && sockets.length) {
+			var socket = sockets[sockets.length - 1];
+			take(socket);
+			if (!socket.destroyed) return req.onSocket(socket);
+		}
+
+		addRequest.apply(this, arguments);
+	};
+}
+
+/**
+ * A pass-through stream that keeps a copy of every chunk of a response going through it.
+ * Chunks only flow as the consumer reads them, so no data is lost until it subscribes.
+ *
+ * The copy is only handed over if the response is whole: it ended normally and its length matches `Content-Length`
+ * if any. Otherwise the stream fails, so that a truncated source is neither cached nor decoded.
+ *
+ * @private
+ * @param {IncomingMessage} res - Response.
+ * @param {function} callback - Invoked with the whole response data.
+ * @constructor
+ */
+function Tee(res, callback) {
+	Transform.call(this);
+	this.res = res;
+	this.callback = callback;
+	this.chunks = [];
+	this.length = 0;
+	this.aborted = false;
+
+	res.on('aborted', function() {
+		this.aborted = true;
+	}.bind(this));
+}
+
+util.inherits(Tee, Transform);
+
+Tee.prototype._transform = function(chunk, encoding, callback) {
+	this.chunks.push(chunk);
+	this.length += chunk.length;
+	callback(null, chunk);
+};
+
+Tee.prototype._flush = function(callback) {
+	var expected = this.res.headers['content-length'];
+
+	if (this.aborted || !this.res.complete || (null != expected && Number(expected) != this.length)) {
+		var err = new Error('origin error: truncated response');
+		err.status = 502;
+		return callback(err);
+	}
+
+	this.callback(Buffer.concat(this.chunks));
+	callback();
+};
+
+/**
+ * Creates an error mirroring an origin status code.
+ * Not found sources stay not found, others are reported as a bad gateway.
+ *
+ * @private
+ */
+function originError(href, statusCode) {
+	var err = new Error('origin error: ' + statusCode + ' for ' + href);
+	err.status = (404 == statusCode ? 404 : 502);
+	return err;
+}
+
+/**
+ * Export.
+ */
+
+module.exports = Origin;
@@ -17,6 +17,7 @@ var util = require('util'),
 	utils = require('./utils'),
 	check = utils.checkType,
 	hooks = require('./hooks'),
+	bindings = require('./bindings'),
 	createStream = require('./stream').createStream;
 
 /**
@@ -41,6 +42,8 @@ function Pipeline() {
 	this.queue = [];
 	// shared params
 	this.sharedParams = {};
+	// ids of native operations of the current step, to cancel them on abort
+	this.running = [];
 }
 
 util.inherits(Pipeline, EventEmitter);
@@ -107,7 +110,7 @@ Pipeline.prototype.use = function(name, params) {
 		var configuredOperation = invokeOperation.bind(this, operation, params);
 
 		// mark it
-		mark(configuredOperation, name);
+		mark(configuredOperation, name, params);
 
 		// `from` is always inserted at the top of the queue
 		if ('from' == name)
@@ -126,6 +129,10 @@ Pipeline.prototype.use = function(name, params) {
 };
 
 /**
+ * Runs enqueued operations.
+ *
+ * When the pipeline writes its image with `to`, pixels are only decoded if an operation needs them. The image given
+ * to `callback` may then hold no pixels (see `Image#pending`).
  *
  * @param {function} [callback]
  */
@@ -170,6 +177,48 @@ Pipeline.prototype.clear = function() {
 	this.queue.length = 0;
 	this.sharedParams = {};
 	this.error = undefined;
+	this.aborted = undefined;
+	this.running.length = 0;
+	clearTimeout(this.timer);
+	return this;
+};
+
+/**
+ * Aborts the pipeline.
+ * Native operations of the current step are cancelled (see `ribs.cancel`) and no further operation is invoked. The
+ * pipeline ends with `err`.
+ *
+ * @param {Error} [err] - Reason, defaults to a `pipeline aborted` error.
+ * @return {Pipeline}
+ */
+Pipeline.prototype.abort = function(err) {
+	// already aborted
+	if (this.aborted) return this;
+
+	this.aborted = err || new Error('pipeline aborted');
+	this.running.forEach(bindings.cancel);
+	this.running.length = 0;
+
+	return this;
+};
+
+/**
+ * Aborts the pipeline if it has not ended within `ms` milliseconds.
+ * The pipeline then ends with a `deadline exceeded` error, having a `503` status.
+ *
+ * @param {number} ms - Deadline, in milliseconds from now.
+ * @return {Pipeline}
+ */
+Pipeline.prototype.deadline = function(ms) {
+	check('ms', ms, false, 'number');
+
+	clearTimeout(this.timer);
+	this.timer = setTimeout(function() {
+		var err = new Error('deadline exceeded');
+		err.status = 503;
+		this.abort(err);
+	}.bind(this), ms);
+
 	return this;
 };
 
@@ -181,6 +230,143 @@ Pipeline.prototype.stream = function(params) {
 	return createStream(this, params);
 };
 
+/**
+ * Returns names of enqueued operations acting on pixels, that is all of them except `from` and `to`.
+ * This lets an operation know what's coming next in order to take shortcuts.
+ *
+ * @return {Array}
+ */
+Pipeline.prototype.pixelOperations = function() {
+	return _(this.queue).pluck('_name').without('from', 'to').value();
+};
+
+/**
+ * Returns params of the first enqueued operation with the given name.
+ *
+ * @param {string} name - Operation name.
+ * @return {*} - Operation params, `undefined` if not enqueued.
+ */
+Pipeline.prototype.paramsOf = function(name) {
+	var operation = _.find(this.queue, { _name: name });
+	if (operation) return operation._params;
+};
+
+/**
+ * Replaces params of the first enqueued operation with the given name.
+ * This is only meant to be used by operations that resolve params of following ones ahead of time.
+ *
+ * @param {string} name - Operation name.
+ * @param {*} params - New params.
+ * @return {Pipeline}
+ */
+Pipeline.prototype.rebind = function(name, params) {
+	var queue = this.queue,
+		i = _.findIndex(queue, { _name: name });
+
+	if (~i) {
+		var operation = Pipeline.operations[name];
+		queue[i] = invokeOperation.bind(this, operation, params);
+		mark(queue[i], name, params);
+	}
+
+	return this;
+};
+
+/**
+ * Enqueues a plan compiled with `Pipeline.compile`.
+ * Operations have already been resolved and checked, so nothing is validated again. Params of the plan are copied,
+ * as operations may alter their params while running (constraints hooks, snapped crop origin, encoding outcome...).
+ *
+ * @param {array} plan - Compiled plan.
+ * @param {object} [params] - Params overriding those of the plan, by operation name. This is typically used for `from`
+ * and `to`, that change on each run.
+ * @return {Pipeline}
+ */
+Pipeline.prototype.enqueue = function(plan, params) {
+	var queue = this.queue;
+
+	for (var i = 0, len = plan.length; i < len; i++) {
+		var step = plan[i],
+			stepParams = (params && params[step.name]) || copy(step.params) || this.sharedParams,
+			configuredOperation = invokeOperation.bind(this, step.operation, stepParams);
+
+		mark(configuredOperation, step.name, stepParams);
+
+		// `from` is always inserted at the top of the queue
+		if ('from' == step.name)
+			queue.unshift(configuredOperation);
+		else
+			queue.push(configuredOperation);
+	}
+
+	return this;
+};
+
+/**
+ * Compiles a bulk of operations into a plan that can be enqueued into any number of pipelines.
+ * This resolves and validates operations once, which is meant for bulks that are run over and over.
+ *
+ * @param {array} bulk - Bulk of operations, like `use` accepts.
+ * @return {array} - Compiled plan.
+ */
+Pipeline.compile = function(bulk) {
+	check('bulk', bulk, false, 'array');
+
+	var locked = {};
+
+	return bulk.map(function(step) {
+		var name = step.operation;
+		check('name', name, false, 'string');
+
+		var operation = Pipeline.operations[name];
+		if ('function' != typeof operation)
+			throw new Error('no operation found: ' + name);
+
+		// `from` and `to` must not have duplicates
+		if (~'from|to'.indexOf(name)) {
+			if (locked[name]) throw new Error('duplicate of ' + name + ' found');
+			locked[name] = true;
+		}
+
+		return { name: name, operation: operation, params: step.params };
+	});
+};
+
+/**
+ * Tracks a native operation started by an operation, so that it can be cancelled if the pipeline is aborted.
+ * Operations may be invoked out of any pipeline, in which case this does nothing.
+ *
+ * @param {Pipeline} [pipeline] - Pipeline invoking the operation.
+ * @param {number} id - Native operation id, as returned by `Image` methods.
+ * @return {number} - The id.
+ */
+Pipeline.track = function(pipeline, id) {
+	if (pipeline instanceof Pipeline) {
+		// aborted meanwhile
+		if (pipeline.aborted) bindings.cancel(id);
+		else pipeline.running.push(id);
+	}
+
+	return id;
+};
+
+/**
+ * Decodes pixels of an image lazily decoded by `from`, before an operation touches them.
+ * Images already decoded are given back right away.
+ *
+ * @param {Pipeline} [pipeline] - Pipeline invoking the operation.
+ * @param {Image} image - Image.
+ * @param {function} callback - Invoked with `(err, image)`.
+ */
+Pipeline.load = function(pipeline, image, callback) {
+	if (!image || !image.pending) return callback(null, image);
+
+	var pending = image.pending;
+	image.pending = null;
+
+	Pipeline.track(pipeline, image.load(pending, callback));
+};
+
 /**
  *
  * @param name
@@ -248,8 +434,8 @@ Pipeline.hooks = {};
  * @param res
  */
 function finalize(callback, err, res) {
-	// cache error locally
-	err = err || this.error;
+	// cache error locally, the abort reason prevails over the error of cancelled operations
+	err = this.aborted || err || this.error;
 
 	// clear before invoking callback
 	this.clear();
@@ -294,6 +480,21 @@ function invokeOperation(operation, params, image, callback) {
 	// juggle arguments for `from` operation
 	if (fromOp) callback = image;
 
+	// aborted, stop here
+	if (this.aborted) return callback(this.aborted);
+
+	// native operations of the previous step are over
+	this.running.length = 0;
+
+	// unless told otherwise, an operation may alter pixels in any way.
+	// original bytes of the image can't be trusted anymore.
+	if (!fromOp && image && !operation.keepsSource)
+		image.source = null;
+
+	// same goes for frames of an animation, only operations able to replay themselves on each frame keep it
+	if (!fromOp && image && !operation.keepsAnimation)
+		image.animation = null;
+
 	// wrap the callback to emit the `after` event
 	var wrappedCallback = function() {
 		// `operation:after` event
@@ -303,11 +504,23 @@ function invokeOperation(operation, params, image, callback) {
 		callback.apply(this, arguments);
 	}.bind(this);
 
+	var invoke = function() {
+		finalParams = operation.call(this,
+			params,
+			fromOp ? wrappedCallback : image,
+			fromOp ? undefined : wrappedCallback);
+	}.bind(this);
+
+	// pixels of a lazily decoded image are loaded beforehand, unless the operation does it only when needed
+	if (!fromOp && image && image.pending && !operation.loadsPixels) {
+		return Pipeline.load(this, image, function(err) {
+			if (err) return callback(err, image);
+			invoke();
+		});
+	}
+
 	// invoke operation
-	finalParams = operation.call(this,
-		params,
-		fromOp ? wrappedCallback : image,
-		fromOp ? undefined : wrappedCallback);
+	invoke();
 }
 
 function lock(queue, name) {
@@ -317,8 +530,19 @@ function lock(queue, name) {
 	queue['_' + name + 'Lock'] = true;
 }
 
-function mark(operation, name) {
+function mark(operation, name, params) {
 	operation._name = name.name || name;
+	operation._params = params;
+}
+
+/**
+ * Shallow copy of plan params.
+ * Operations replace nested values instead of altering them, so copying the first level is enough.
+ *
+ * @private
+ */
+function copy(params) {
+	return (Array.isArray(params) || _.isPlainObject(params) ? _.clone(params) : params);
 }
 
 function ensureLast(queue) {
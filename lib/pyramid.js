@@ -0,0 +1,339 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+'use strict';
+
+/**
+ * Module dependencies.
+ */
+
+var fs = require('fs'),
+	path = require('path'),
+	crypto = require('crypto'),
+	mkdirp = require('mkdirp'),
+	async = require('async');
+
+/**
+ * Pyramid file format constants.
+ *
+ * A pyramid file is laid out like this, all numbers being unsigned big endian 32 bits integers:
+ *
+ *   magic (RIBP) | version | levels count | source width | source height
+ *   level 1: width | height | offset | length
+ *   ...
+ *   level n: width | height | offset | length
+ *   level 1 data | ... | level n data
+ *
+ * Each level is half the size of the previous one and is encoded in the source format, so that it can be decoded as
+ * is. The full resolution level is the source itself and is not stored. Every level is downscaled from the full
+ * resolution pixels and encoded once, so that JPEG losses do not add up from one level to the next.
+ */
+var MAGIC = 0x52494250,
+	VERSION = 1,
+	HEADER_SIZE = 20,
+	LEVEL_SIZE = 16,
+	MAX_LEVELS = 8,
+	FORMATS = ['jpg', 'png', 'bmp'];
+
+/**
+ * A `Pyramid` stores, for each source image, a set of downscaled versions of it (1/2, 1/4, 1/8...).
+ * Resizing to an arbitrary size can then start from the smallest level that is still larger than the target, instead
+ * of decoding the full resolution source.
+ *
+ * Pyramids are keyed by source path, size and modification time so they are never stale. Files of a source are
+ * prefixed by a hash of its path, so that the previous pyramid is removed once a new one is built.
+ *
+ * @param {string} dir - Directory where pyramids are stored.
+ * @param {object} [options] - Options.
+ * @param {number} [options.minSize] - Smallest dimension of the last level, defaults to `64`.
+ * @param {number} [options.maxLevels] - Maximum number of levels, defaults to `4`.
+ * @param {number} [options.quality] - Quality of JPEG levels, defaults to `95`.
+ * @constructor
+ */
+function Pyramid(dir, options) {
+	// shortcut syntax
+	if (!(this instanceof Pyramid)) return new Pyramid(dir, options);
+
+	if (!dir) throw new Error('pyramid directory required');
+
+	options = options || {};
+
+	this.dir = dir;
+	this.minSize = options.minSize || 64;
+	this.maxLevels = Math.min(options.maxLevels || 4, MAX_LEVELS);
+	this.quality = options.quality || 95;
+
+	// pyramids being built, to avoid building them twice
+	this.building = {};
+}
+
+/**
+ * Returns the pyramid filename of a source image.
+ *
+ * @param {string} src - Source image filename.
+ * @param {fs.Stats} stat - Source image stats.
+ * @return {string}
+ */
+Pyramid.prototype.filename = function(src, stat) {
+	var prefix = sha1(path.resolve(src)),
+		version = sha1(stat.size + ':' + stat.mtime.getTime());
+
+	return path.join(this.dir, prefix.slice(0, 2), prefix + '-' + version + '.ribp');
+};
+
+/**
+ * Opens the pyramid of a source image and reads its header.
+ *
+ * The callback is invoked with `(err, header, stat)`, `header` being `null` if the pyramid does not exist yet. A header
+ * holds source `width` and `height`, `levels` and an open file descriptor (`fd`) that must be released with `close`.
+ *
+ * @param {string} src - Source image filename.
+ * @param {function} callback
+ */
+Pyramid.prototype.open = function(src, callback) {
+	fs.stat(src, function(err, stat) {
+		if (err) return callback(err);
+
+		var filename = this.filename(src, stat);
+
+		fs.open(filename, 'r', function(err, fd) {
+			// not built yet
+			if (err) return callback(null, null, stat);
+
+			var buffer = new Buffer(HEADER_SIZE + MAX_LEVELS * LEVEL_SIZE);
+
+			fs.read(fd, buffer, 0, buffer.length, 0, function(err, bytesRead) {
+				var header = !err && parseHeader(buffer, bytesRead);
+
+				// corrupted or outdated, ignore it
+				if (!header) {
+					fs.close(fd, function() {});
+					return callback(null, null, stat);
+				}
+
+				header.fd = fd;
+				callback(null, header, stat);
+			});
+		});
+	}.bind(this));
+};
+
+/**
+ * Reads the encoded data of a level.
+ *
+ * @param {object} header - Pyramid header, as given by `open`.
+ * @param {object} level - One of `header.levels`.
+ * @param {function} callback - Invoked with `(err, buffer)`.
+ */
+Pyramid.prototype.read = function(header, level, callback) {
+	var buffer = new Buffer(level.length);
+
+	fs.read(header.fd, buffer, 0, level.length, level.offset, function(err, bytesRead) {
+		if (!err && bytesRead != level.length)
+			err = new Error('truncated pyramid level');
+
+		callback(err, buffer);
+	});
+};
+
+/**
+ * Releases a pyramid opened with `open`.
+ *
+ * @param {object} header - Pyramid header.
+ */
+Pyramid.prototype.close = function(header) {
+	if (header && null != header.fd) {
+		fs.close(header.fd, function() {});
+		header.fd = null;
+	}
+};
+
+/**
+ * Builds and persists the pyramid of a source image, from its already decoded pixels.
+ * Levels are downscaled natively from a snapshot of those, so the image can go on being processed meanwhile. Once
+ * written, pyramids of previous versions of the source are removed.
+ *
+ * @param {string} src - Source image filename.
+ * @param {fs.Stats} stat - Source image stats.
+ * @param {Image} image - Decoded source image.
+ * @param {function} [callback] - Invoked with `(err)`.
+ */
+Pyramid.prototype.build = function(src, stat, image, callback) {
+	var filename = this.filename(src, stat),
+		building = this.building,
+		format = image.originalFormat,
+		width = image.width,
+		height = image.height,
+		sizes = [];
+
+	callback = callback || function() {};
+
+	// already on it
+	if (building[filename]) return callback(null);
+
+	// not worth it or not encodable
+	if (!~FORMATS.indexOf(format) || Math.min(width, height) < this.minSize * 2)
+		return callback(null);
+
+	// each level is half the size of the previous one
+	var w = width,
+		h = height;
+
+	while (sizes.length < this.maxLevels && Math.min(w / 2, h / 2) >= this.minSize) {
+		w = Math.round(w / 2);
+		h = Math.round(h / 2);
+		sizes.push({ width: w, height: h });
+	}
+
+	var done = function(err) {
+		delete building[filename];
+		callback(err);
+	};
+
+	building[filename] = true;
+
+	try {
+		image.levels(format, ('jpg' == format ? this.quality : 0), sizes, function(err, buffers) {
+			if (err) return done(err);
+
+			var levels = sizes.map(function(size, i) {
+				return { width: size.width, height: size.height, data: buffers[i] };
+			});
+
+			write(filename, width, height, levels, function(err) {
+				if (err) return done(err);
+				removeStale(filename, done);
+			});
+		});
+	}
+	catch (err) {
+		done(err);
+	}
+};
+
+/**
+ * Selects the smallest level at least as large as the given size.
+ *
+ * @param {object} header - Pyramid header.
+ * @param {number} width - Target width.
+ * @param {number} height - Target height.
+ * @return {object|undefined} - The level, nothing if the source itself should be used.
+ */
+Pyramid.select = function(header, width, height) {
+	var selected;
+
+	header.levels.forEach(function(level) {
+		if (level.width >= width && level.height >= height)
+			selected = level;
+	});
+
+	return selected;
+};
+
+/**
+ * Parses a pyramid header.
+ *
+ * @private
+ */
+function parseHeader(buffer, length) {
+	if (length < HEADER_SIZE) return;
+	if (MAGIC != buffer.readUInt32BE(0) || VERSION != buffer.readUInt32BE(4)) return;
+
+	var count = buffer.readUInt32BE(8);
+	if (count > MAX_LEVELS || length < HEADER_SIZE + count * LEVEL_SIZE) return;
+
+	var header = {
+		width: buffer.readUInt32BE(12),
+		height: buffer.readUInt32BE(16),
+		levels: []
+	};
+
+	for (var i = 0, offset = HEADER_SIZE; i < count; i++, offset += LEVEL_SIZE) {
+		header.levels.push({
+			width: buffer.readUInt32BE(offset),
+			height: buffer.readUInt32BE(offset + 4),
+			offset: buffer.readUInt32BE(offset + 8),
+			length: buffer.readUInt32BE(offset + 12)
+		});
+	}
+
+	return header;
+}
+
+/**
+ * Removes pyramids of other versions of the same source as `filename`.
+ * Files being written by other processes are left alone.
+ *
+ * @private
+ */
+function removeStale(filename, callback) {
+	var dir = path.dirname(filename),
+		basename = path.basename(filename),
+		prefix = basename.slice(0, basename.indexOf('-') + 1);
+
+	fs.readdir(dir, function(err, names) {
+		if (err) return callback(err);
+
+		async.eachSeries(names.filter(function(name) {
+			return (0 === name.indexOf(prefix) && name != basename && '.ribp' == path.extname(name));
+		}), function(name, next) {
+			fs.unlink(path.join(dir, name), function() { next(); });
+		}, callback);
+	});
+}
+
+/**
+ * Hashes a string.
+ *
+ * @private
+ */
+function sha1(str) {
+	return crypto.createHash('sha1').update(str).digest('hex');
+}
+
+/**
+ * Writes a pyramid file atomically.
+ *
+ * @private
+ */
+function write(filename, width, height, levels, callback) {
+	var header = new Buffer(HEADER_SIZE + levels.length * LEVEL_SIZE),
+		offset = header.length;
+
+	header.writeUInt32BE(MAGIC, 0);
+	header.writeUInt32BE(VERSION, 4);
+	header.writeUInt32BE(levels.length, 8);
+	header.writeUInt32BE(width, 12);
+	header.writeUInt32BE(height, 16);
+
+	levels.forEach(function(level, i) {
+		var pos = HEADER_SIZE + i * LEVEL_SIZE;
+		header.writeUInt32BE(level.width, pos);
+		header.writeUInt32BE(level.height, pos + 4);
+		header.writeUInt32BE(offset, pos + 8);
+		header.writeUInt32BE(level.data.length, pos + 12);
+		offset += level.data.length;
+	});
+
+	var data = Buffer.concat([header].concat(levels.map(function(level) { return level.data; }))),
+		tmp = filename + '.' + process.pid + '.tmp';
+
+	// write aside then rename, readers never see a partial file
+	mkdirp(path.dirname(filename), function(err) {
+		if (err) return callback(err);
+
+		fs.writeFile(tmp, data, function(err) {
+			if (err) return callback(err);
+			fs.rename(tmp, filename, callback);
+		});
+	});
+}
+
+/**
+ * Export.
+ */
+
+module.exports = Pyramid;
@@ -11,7 +11,8 @@
  */
 
 var operations = require('./operations'),
-	Pipeline = require('./pipeline');
+	Pipeline = require('./pipeline'),
+	bindings = require('./bindings');
 
 /**
  * Ribs front-end.
@@ -86,6 +87,36 @@ ribs.hook = Pipeline.hook;
 ribs.__defineGetter__('DEBUG', function() { return Pipeline.DEBUG; });
 ribs.__defineSetter__('DEBUG', function(val) { Pipeline.DEBUG = val; });
 
+/**
+ * Native operations estimated to process less bytes than this threshold are not worth a thread pool hop, they are
+ * processed inline on the main thread. Callbacks are still invoked asynchronously. `0` disables inline processing.
+ */
+ribs.__defineGetter__('inlineThreshold', function() { return bindings.inlineThreshold(); });
+ribs.__defineSetter__('inlineThreshold', function(val) { bindings.inlineThreshold(val); });
+
+/**
+ * Returns native operations counters:
+ *  - `inline`: number of operations processed inline.
+ *  - `queued`: number of operations processed in the thread pool.
+ *
+ * @return {object}
+ */
+ribs.stats = function() {
+	return bindings.stats();
+};
+
+/**
+ * Cancels a native operation, given the id returned by `Image` methods.
+ * Its callback is then invoked with an `operation cancelled` error, unless it was already processed. A running
+ * operation stops at its next check, if it has any, its output being discarded either way.
+ *
+ * @param {number} id - Operation id.
+ * @return {boolean} - `false` if the operation is already over.
+ */
+ribs.cancel = function(id) {
+	return bindings.cancel(id);
+};
+
 /**
  * Export.
  */
@@ -97,4 +128,6 @@ module.exports.Stream = require('./stream').Stream;
 module.exports.createStream = require('./stream').createStream;
 module.exports.operations = operations;
 module.exports.middleware = require('./middleware');
+module.exports.Pyramid = require('./pyramid');
+module.exports.Store = require('./store');
 module.exports.utils = require('./utils');
\ No newline at end of file
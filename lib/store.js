@@ -0,0 +1,693 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+'use strict';
+
+/**
+ * Module dependencies.
+ */
+
+var fs = require('fs'),
+	path = require('path'),
+	crypto = require('crypto'),
+	mkdirp = require('mkdirp'),
+	async = require('async'),
+	bindings = require('./bindings');
+
+/**
+ * Segment file format constants.
+ *
+ * A segment file is a header followed by records appended one after the other, all numbers being unsigned big endian
+ * 32 bits integers:
+ *
+ *   magic (RIBC) | version
+ *   record 1: checksum | key length | data length | key | data
+ *   ...
+ *   record n: checksum | key length | data length | key | data
+ *
+ * The checksum covers lengths, key and data, so that a record torn by a crash is detected and dropped on recovery.
+ * Once a segment is full it is sealed: synced to disk and described by a hint file listing its records, which is read
+ * instead of the segment itself on startup.
+ */
+var MAGIC = 0x52494243,
+	VERSION = 1,
+	HEADER_SIZE = 8,
+	RECORD_HEADER_SIZE = 12,
+	RE_SEGMENT = /^([0-9a-f]{8})\.seg$/;
+
+/**
+ * Sealed segments holding less live data than this ratio are compacted.
+ */
+var COMPACT_RATIO = 0.5;
+
+/**
+ * A `Store` is an on-disk cache of processed images made of a few large append-only segment files, instead of one file
+ * per image. An in-memory index maps each key to the segment, offset and length of its data, so that a hit costs a
+ * single positioned read, or a single `sendfile` when it is written straight to a socket.
+ *
+ * As soon as the store grows past `maxSize`, the oldest segment is evicted: entries read since they were written get a
+ * second chance and are appended again, others are dropped. Segments mostly holding overwritten entries are compacted
+ * the same way, keeping all their live entries. Both run in the background, one segment at a time. Segments are sealed
+ * past a quarter of `maxSize` if that is smaller than `segmentSize`, so that there is always an old one to evict.
+ *
+ * Segments are loaded synchronously on creation, the last one being verified and truncated after its last valid
+ * record. A store directory must not be shared by several processes.
+ *
+ * @param {string} dir - Directory where segments are stored.
+ * @param {object} [options] - Options.
+ * @param {number} [options.maxSize] - Maximum size of the store in bytes, defaults to 1GB.
+ * @param {number} [options.segmentSize] - Size in bytes past which a segment is sealed, defaults to 64MB.
+ * @constructor
+ */
+function Store(dir, options) {
+	// shortcut syntax
+	if (!(this instanceof Store)) return new Store(dir, options);
+
+	if (!dir) throw new Error('store directory required');
+
+	options = options || {};
+
+	this.dir = dir;
+	this.maxSize = options.maxSize || 1024 * 1024 * 1024;
+	this.segmentSize = Math.min(options.segmentSize || 64 * 1024 * 1024, Math.ceil(this.maxSize / 4));
+
+	// key -> { segment, offset, length, size, hot }
+	this.entries = Object.create(null);
+	this.segments = [];
+	this.size = 0;
+
+	// appends are serialized
+	this.writer = async.queue(function(task, done) {
+		task.run(done);
+	}, 1);
+
+	// callbacks waiting for background maintenance to be over
+	this.idle = [];
+
+	this.load();
+}
+
+/**
+ * Reads the data of an entry.
+ *
+ * @param {string} key
+ * @param {function} callback - Invoked with `(err, data)`, `data` being `null` if there is no such entry.
+ */
+Store.prototype.get = function(key, callback) {
+	var entry = this.entries[key];
+
+	// segments may not be open anymore
+	if (this.closed) {
+		return process.nextTick(function() {
+			callback(new Error('store closed'), null);
+		});
+	}
+
+	if (!entry) {
+		return process.nextTick(function() {
+			callback(null, null);
+		});
+	}
+
+	var segment = entry.segment,
+		buffer = new Buffer(entry.length);
+
+	entry.hot = true;
+	segment.readers++;
+
+	fs.read(segment.fd, buffer, 0, entry.length, entry.offset, function(err, bytesRead) {
+		release(segment);
+
+		if (!err && bytesRead != entry.length)
+			err = new Error('truncated store entry');
+
+		callback(err, err ? null : buffer);
+	});
+};
+
+/**
+ * Writes an entry to a socket, straight from its segment: the kernel copies it from the page cache to the socket, the
+ * data never going through JavaScript. `header` is written first, along with it.
+ *
+ * Nothing waits for a slow client: what the socket does not take right away is read and written through it as usual.
+ * The socket must have nothing pending to write, and must not be written to until the callback is invoked.
+ *
+ * @param {string} key
+ * @param {Socket} socket - Plain TCP socket.
+ * @param {function} header - Invoked with the length of the entry, if it exists, returns a buffer to write first.
+ * @param {function} callback - Invoked with `(err, found)`, once everything is written or handed over to the socket.
+ */
+Store.prototype.send = function(key, socket, header, callback) {
+	var entry = this.entries[key],
+		closed = this.closed;
+
+	if (closed || !entry) {
+		return process.nextTick(function() {
+			callback(closed ? new Error('store closed') : null, false);
+		});
+	}
+
+	var segment = entry.segment,
+		head = header(entry.length);
+
+	entry.hot = true;
+	segment.readers++;
+
+	bindings.sendfile(socket._handle.fd, segment.fd, entry.offset, entry.length, head, function(err, sent) {
+		if (err) {
+			release(segment);
+			return callback(err, true);
+		}
+
+		// the socket buffer is full, the rest goes through the event loop
+		var skipped = Math.max(0, sent - head.length),
+			rest = new Buffer(entry.length - skipped);
+
+		if (sent < head.length) socket.write(head.slice(sent));
+
+		if (0 === rest.length) {
+			release(segment);
+			return callback(null, true);
+		}
+
+		fs.read(segment.fd, rest, 0, rest.length, entry.offset + skipped, function(err, bytesRead) {
+			release(segment);
+
+			if (!err && bytesRead != rest.length)
+				err = new Error('truncated store entry');
+
+			if (!err) socket.write(rest);
+			callback(err, true);
+		});
+	});
+};
+
+/**
+ * Appends an entry, replacing the previous one with the same key if any.
+ * The entry is visible to `get` once written.
+ *
+ * @param {string} key
+ * @param {Buffer} data
+ * @param {function} [callback] - Invoked with `(err)`.
+ */
+Store.prototype.set = function(key, data, callback) {
+	callback = callback || function() {};
+
+	this.writer.push({
+		run: function(done) {
+			append(this, key, data, null, done);
+		}.bind(this)
+	}, callback);
+};
+
+/**
+ * Tells if the store holds an entry.
+ *
+ * @param {string} key
+ * @return {boolean}
+ */
+Store.prototype.has = function(key) {
+	return !!this.entries[key];
+};
+
+/**
+ * Waits for pending appends to be written and background maintenance to be over.
+ *
+ * @param {function} callback - Invoked with `(err)`.
+ */
+Store.prototype.flush = function(callback) {
+	this.writer.push({
+		run: function(done) {
+			done();
+		}
+	}, function(err) {
+		if (err) return callback(err);
+
+		this.idle.push(callback);
+		maintain(this);
+	}.bind(this));
+};
+
+/**
+ * Closes the store once pending appends are written.
+ *
+ * @param {function} [callback] - Invoked with `(err)`.
+ */
+Store.prototype.close = function(callback) {
+	callback = callback || function() {};
+
+	this.writer.push({
+		run: function(done) {
+			this.closed = true;
+
+			var active = this.active;
+			fs.fsync(active.fd, function(err) {
+				this.segments.forEach(function(segment) {
+					segment.removed = true;
+					if (0 === segment.readers) fs.closeSync(segment.fd);
+				});
+				done(err);
+			}.bind(this));
+		}.bind(this)
+	}, callback);
+};
+
+/**
+ * Loads segments, rebuilding the index.
+ *
+ * @private
+ */
+Store.prototype.load = function() {
+	mkdirp.sync(this.dir);
+
+	var ids = fs.readdirSync(this.dir)
+		.filter(function(name) { return RE_SEGMENT.test(name); })
+		.map(function(name) { return parseInt(RE_SEGMENT.exec(name)[1], 16); })
+		.sort(function(a, b) { return a - b; });
+
+	ids.forEach(function(id, i) {
+		var segment = openSegment(this, id, 'r+'),
+			last = (ids.length - 1 == i);
+
+		// sealed segments are described by their hint, the last one is verified record by record
+		if (!last && loadHint(this, segment)) return;
+
+		if (!scan(this, segment, last)) {
+			// not a segment, or created but never written
+			fs.closeSync(segment.fd);
+			this.segments.pop();
+			fs.unlinkSync(segment.filename);
+			return;
+		}
+
+		// appends resume where the last run stopped
+		if (last) this.active = segment;
+		else writeHint(this, segment);
+	}, this);
+
+	if (this.active && this.active.size >= this.segmentSize) {
+		writeHint(this, this.active);
+		this.active = null;
+	}
+
+	if (!this.active)
+		this.active = createSegment(this, ids.length ? ids[ids.length - 1] + 1 : 0);
+};
+
+/**
+ * Opens a segment file and registers it.
+ *
+ * @private
+ */
+function openSegment(store, id, flags) {
+	var name = ('0000000' + id.toString(16)).slice(-8),
+		segment = {
+			id: id,
+			filename: path.join(store.dir, name + '.seg'),
+			hintFilename: path.join(store.dir, name + '.hint'),
+			size: 0,
+			live: 0,
+			keys: Object.create(null),
+			readers: 0
+		};
+
+	segment.fd = fs.openSync(segment.filename, flags);
+	store.segments.push(segment);
+
+	return segment;
+}
+
+/**
+ * Creates a new, empty, segment.
+ *
+ * @private
+ */
+function createSegment(store, id) {
+	var segment = openSegment(store, id, 'w+'),
+		header = new Buffer(HEADER_SIZE);
+
+	header.writeUInt32BE(MAGIC, 0);
+	header.writeUInt32BE(VERSION, 4);
+	fs.writeSync(segment.fd, header, 0, HEADER_SIZE, 0);
+
+	segment.size = HEADER_SIZE;
+	store.size += HEADER_SIZE;
+
+	return segment;
+}
+
+/**
+ * Indexes the records of a segment by reading them.
+ *
+ * When `verify` is set, checksums are checked and the segment is truncated after its last valid record: this is the
+ * segment that was being appended to, its tail may have been torn by a crash. Sealed segments were synced before being
+ * sealed, only their headers are read.
+ *
+ * @private
+ * @return {boolean} - `false` if this is not a valid segment.
+ */
+function scan(store, segment, verify) {
+	var fd = segment.fd,
+		fileSize = fs.fstatSync(fd).size,
+		header = new Buffer(RECORD_HEADER_SIZE),
+		position = HEADER_SIZE;
+
+	if (fileSize < HEADER_SIZE ||
+		HEADER_SIZE != fs.readSync(fd, header, 0, HEADER_SIZE, 0) ||
+		MAGIC != header.readUInt32BE(0) || VERSION != header.readUInt32BE(4))
+		return false;
+
+	while (position + RECORD_HEADER_SIZE <= fileSize) {
+		fs.readSync(fd, header, 0, RECORD_HEADER_SIZE, position);
+
+		var keyLength = header.readUInt32BE(4),
+			dataLength = header.readUInt32BE(8),
+			size = RECORD_HEADER_SIZE + keyLength + dataLength;
+
+		if (position + size > fileSize) break;
+
+		var body = new Buffer(verify ? keyLength + dataLength : keyLength);
+		fs.readSync(fd, body, 0, body.length, position + RECORD_HEADER_SIZE);
+
+		if (verify && header.readUInt32BE(0) != checksum(header, body.slice(0, keyLength), body.slice(keyLength)))
+			break;
+
+		index(store, body.toString('utf8', 0, keyLength), segment, position + RECORD_HEADER_SIZE + keyLength,
+			dataLength, size);
+		position += size;
+	}
+
+	// drop the torn tail
+	if (verify && position < fileSize)
+		fs.ftruncateSync(fd, position);
+
+	segment.size = position;
+	store.size += position;
+
+	return true;
+}
+
+/**
+ * Indexes a sealed segment from its hint file.
+ *
+ * @private
+ * @return {boolean} - `false` if there is no usable hint.
+ */
+function loadHint(store, segment) {
+	var hint;
+
+	try {
+		hint = JSON.parse(fs.readFileSync(segment.hintFilename, 'utf8'));
+	}
+	catch (err) {
+		return false;
+	}
+
+	if (!hint || hint.size != fs.fstatSync(segment.fd).size) return false;
+
+	hint.records.forEach(function(record) {
+		var key = record[0];
+		index(store, key, segment, record[1], record[2], RECORD_HEADER_SIZE + Buffer.byteLength(key) + record[2]);
+	});
+
+	segment.size = hint.size;
+	store.size += hint.size;
+
+	return true;
+}
+
+/**
+ * Writes the hint file of a sealed segment, atomically.
+ *
+ * @private
+ */
+function writeHint(store, segment, callback) {
+	var records = Object.keys(segment.keys).map(function(key) {
+		var entry = store.entries[key];
+		return [key, entry.offset, entry.length];
+	});
+
+	var data = JSON.stringify({ size: segment.size, records: records }),
+		tmp = segment.hintFilename + '.tmp';
+
+	if (!callback) {
+		fs.writeFileSync(tmp, data);
+		fs.renameSync(tmp, segment.hintFilename);
+		return;
+	}
+
+	fs.writeFile(tmp, data, function(err) {
+		if (err) return callback(err);
+		fs.rename(tmp, segment.hintFilename, callback);
+	});
+}
+
+/**
+ * Points a key to a record, forgetting its previous one.
+ *
+ * @private
+ */
+function index(store, key, segment, offset, length, size) {
+	unindex(store, key);
+
+	store.entries[key] = {
+		segment: segment,
+		offset: offset,
+		length: length,
+		size: size,
+		hot: false
+	};
+
+	segment.keys[key] = true;
+	segment.live += size;
+}
+
+/**
+ * Forgets a key.
+ *
+ * @private
+ */
+function unindex(store, key) {
+	var entry = store.entries[key];
+	if (!entry) return;
+
+	delete entry.segment.keys[key];
+	entry.segment.live -= entry.size;
+	delete store.entries[key];
+}
+
+/**
+ * Computes the checksum of a record.
+ *
+ * @private
+ */
+function checksum(header, key, data) {
+	return crypto.createHash('md5')
+		.update(header.slice(4, RECORD_HEADER_SIZE))
+		.update(key)
+		.update(data)
+		.digest()
+		.readUInt32BE(0);
+}
+
+/**
+ * Appends a record to the active segment. Only called by the writer.
+ *
+ * If `previous` is given, this is a move from a segment being compacted: the record is only appended if the key still
+ * points to it.
+ *
+ * @private
+ */
+function append(store, key, data, previous, done) {
+	if (store.closed) return done(new Error('store closed'));
+	if (previous && store.entries[key] !== previous) return done();
+
+	var active = store.active,
+		keyBuffer = new Buffer(key, 'utf8'),
+		header = new Buffer(RECORD_HEADER_SIZE),
+		position = active.size;
+
+	header.writeUInt32BE(keyBuffer.length, 4);
+	header.writeUInt32BE(data.length, 8);
+	header.writeUInt32BE(checksum(header, keyBuffer, data), 0);
+
+	var record = Buffer.concat([header, keyBuffer, data]);
+
+	fs.write(active.fd, record, 0, record.length, position, function(err) {
+		// the next append overwrites whatever was partially written
+		if (err) return done(err);
+
+		active.size += record.length;
+		store.size += record.length;
+		index(store, key, active, position + RECORD_HEADER_SIZE + keyBuffer.length, data.length, record.length);
+
+		if (active.size >= store.segmentSize) return seal(store, done);
+
+		// evict as soon as the store is too large, not only once the active segment is full
+		if (store.size > store.maxSize) setImmediate(maintain.bind(null, store));
+		done();
+	});
+}
+
+/**
+ * Seals the active segment and starts a new one. Only called by the writer.
+ *
+ * @private
+ */
+function seal(store, done) {
+	var segment = store.active;
+
+	fs.fsync(segment.fd, function(err) {
+		if (err) return done(err);
+
+		writeHint(store, segment, function(err) {
+			if (err) return done(err);
+
+			try {
+				store.active = createSegment(store, segment.id + 1);
+			}
+			catch (err) {
+				return done(err);
+			}
+
+			setImmediate(maintain.bind(null, store));
+			done();
+		});
+	});
+}
+
+/**
+ * Evicts or compacts a sealed segment, if needed, then looks for another one.
+ * Once there is nothing left to do, callbacks waiting for it are invoked.
+ *
+ * @private
+ */
+function maintain(store) {
+	if (store.maintaining) return;
+	if (store.closed) return idle(store);
+
+	var sealed = store.segments.filter(function(segment) { return segment !== store.active; }),
+		segment,
+		hotOnly = false;
+
+	// too large, evict the oldest segment
+	if (store.size > store.maxSize && sealed.length > 0) {
+		segment = sealed[0];
+		hotOnly = true;
+	}
+	// otherwise compact a segment mostly made of overwritten entries
+	else {
+		segment = sealed.filter(function(segment) {
+			return segment.live < segment.size * COMPACT_RATIO;
+		})[0];
+	}
+
+	if (!segment) return idle(store);
+
+	store.maintaining = true;
+
+	compact(store, segment, hotOnly, function() {
+		store.maintaining = false;
+		maintain(store);
+	});
+}
+
+/**
+ * Invokes callbacks waiting for maintenance to be over.
+ *
+ * @private
+ */
+function idle(store) {
+	var callbacks = store.idle;
+
+	store.idle = [];
+	callbacks.forEach(function(callback) {
+		callback(null);
+	});
+}
+
+/**
+ * Moves live entries of a segment to the active one, then removes it.
+ * If `hotOnly` is set, only entries read since they were written are moved, others are dropped.
+ *
+ * @private
+ */
+function compact(store, segment, hotOnly, callback) {
+	async.eachSeries(Object.keys(segment.keys), function(key, next) {
+		var entry = store.entries[key];
+
+		if (!entry || entry.segment !== segment || store.closed) return next();
+
+		if (hotOnly && !entry.hot) {
+			unindex(store, key);
+			return next();
+		}
+
+		store.get(key, function(err, data) {
+			// unreadable, drop it
+			if (err || !data) {
+				if (store.entries[key] === entry) unindex(store, key);
+				return next();
+			}
+
+			store.writer.push({
+				run: function(done) {
+					append(store, key, data, entry, done);
+				}
+			}, function() {
+				next();
+			});
+		});
+	}, function() {
+		if (store.closed) return callback();
+
+		// moved entries must be on disk before their former segment goes away
+		fs.fsync(store.active.fd, function() {
+			remove(store, segment, callback);
+		});
+	});
+}
+
+/**
+ * Removes a segment and its remaining entries.
+ * Its entries are gone right away, the callback is invoked once its files are.
+ *
+ * @private
+ */
+function remove(store, segment, callback) {
+	Object.keys(segment.keys).forEach(function(key) {
+		unindex(store, key);
+	});
+
+	store.segments.splice(store.segments.indexOf(segment), 1);
+	store.size -= segment.size;
+	segment.removed = true;
+
+	// the hint goes first, a segment without hint is scanned on startup
+	fs.unlink(segment.hintFilename, function() {
+		fs.unlink(segment.filename, function() {
+			callback();
+		});
+	});
+
+	if (0 === segment.readers) fs.close(segment.fd, function() {});
+}
+
+/**
+ * Releases a segment after a read, closing it if it has been removed meanwhile.
+ *
+ * @private
+ */
+function release(segment) {
+	if (0 === --segment.readers && segment.removed)
+		fs.close(segment.fd, function() {});
+}
+
+/**
+ * Export.
+ */
+
+module.exports = Store;
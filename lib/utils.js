@@ -82,6 +82,55 @@ utils.computeFormula = function(formula, number) {
 	return number;
 };
 
+/**
+ * Matches a sharpen specification: `s<amount>[_<radius>[_<threshold>]]`.
+ *
+ * @type {RegExp}
+ */
+var RE_SHARPEN = /^s(-?\d+(?:\.\d+)?)(?:_(\d+(?:\.\d+)?))?(?:_(\d+))?$/;
+
+/**
+ * Tells whether a value is a sharpen specification.
+ *
+ * @param {*} spec - Value to test.
+ * @return {boolean}
+ */
+utils.isSharpen = function(spec) {
+	return ('string' == typeof spec && RE_SHARPEN.test(spec));
+};
+
+/**
+ * Parses an unsharp mask specification.
+ * A specification is either a string like `s80_1.5_2` or an object with the same values. The values are:
+ *  - `amount`: percentage of the difference with the blurred image to add, a negative value blurs.
+ *  - `radius`: radius of the gaussian blur, in pixels. Defaults to `1`.
+ *  - `threshold`: minimal difference with the blurred image to sharpen a pixel (0-255). Defaults to `0`.
+ *
+ * @param {string|object} spec - The specification to parse.
+ * @return {object} - An object holding `amount`, `radius` and `threshold` values.
+ */
+utils.parseSharpen = function(spec) {
+	var sharpen;
+
+	if ('string' == typeof spec) {
+		var m = RE_SHARPEN.exec(spec);
+		if (!m) throw new Error('invalid sharpen: ' + spec);
+
+		sharpen = { amount: parseFloat(m[1]), radius: m[2], threshold: m[3] };
+	}
+	else
+		sharpen = _.clone(spec);
+
+	sharpen.amount = Number(sharpen.amount) || 0;
+	sharpen.radius = null == sharpen.radius ? 1 : Number(sharpen.radius);
+	sharpen.threshold = null == sharpen.threshold ? 0 : Number(sharpen.threshold);
+
+	if (!(sharpen.radius > 0) || !(sharpen.threshold >= 0))
+		throw new Error('invalid sharpen: ' + JSON.stringify(spec));
+
+	return sharpen;
+};
+
 /**
 * Fetch origin point of an region (top left), relative to a given origin and anchor.
 *
@@ -0,0 +1,821 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#include "gif.h"
+#include "palette.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+using namespace std;
+using namespace ribs;
+
+/**
+ * Number of LZW codes, codes being at most 12 bits long.
+ */
+#define MAX_CODES 4096
+
+/**
+ * Size of the LZW encoder hash table, a prime larger than the number of codes.
+ */
+#define HASH_SIZE 5003
+
+/**
+ * Alpha value under which a pixel is written transparent.
+ */
+#define ALPHA_THRESHOLD 128
+
+/**
+ * Maximum number of pixels of the logical screen, so that a forged header can't make us allocate gigabytes.
+ */
+#define MAX_PIXELS (1 << 26)
+
+/**
+ * A frame being decoded.
+ */
+struct Frame {
+	uint32_t       x;
+	uint32_t       y;
+	uint32_t       width;
+	uint32_t       height;
+	bool           interlaced;
+	int            transparent;
+	int            disposal;
+	uint32_t       delay;
+	const uint8_t* palette;
+	size_t         colors;
+};
+
+/**
+ * Decodes LZW compressed indices. Corrupted data stops decoding, leaving the remaining indices untouched.
+ */
+static bool LzwDecode(const uint8_t* in, size_t length, int minCode, uint8_t* out, size_t outLength) {
+	if (minCode < 2 || minCode > 8) return false;
+
+	uint16_t prefix[MAX_CODES];
+	uint8_t  suffix[MAX_CODES], first[MAX_CODES], stack[MAX_CODES + 1];
+
+	int clear = 1 << minCode, eoi = clear + 1, next = clear + 2, codeSize = minCode + 1, old = -1;
+	uint32_t bits = 0;
+	int      count = 0;
+	size_t   written = 0;
+
+	for (int i = 0; i < clear; i++) {
+		suffix[i] = first[i] = i;
+		prefix[i] = 0;
+	}
+
+	for (size_t pos = 0; written < outLength; ) {
+		// read a code, least significant bits first
+		while (count < codeSize && pos < length) {
+			bits |= uint32_t(in[pos++]) << count;
+			count += 8;
+		}
+		if (count < codeSize) break;
+
+		int code = bits & ((1 << codeSize) - 1);
+		bits >>= codeSize;
+		count -= codeSize;
+
+		if (clear == code) {
+			next = clear + 2;
+			codeSize = minCode + 1;
+			old = -1;
+			continue;
+		}
+		if (eoi == code) break;
+
+		if (old < 0) {
+			if (code >= clear) break;
+			out[written++] = code;
+			old = code;
+			continue;
+		}
+
+		int in = code, sp = 0;
+
+		// KwKwK, the code being defined right now
+		if (code >= next) {
+			if (code > next) break;
+			stack[sp++] = first[old];
+			code = old;
+		}
+
+		while (code >= clear) {
+			stack[sp++] = suffix[code];
+			code = prefix[code];
+		}
+		stack[sp++] = code;
+
+		if (next < MAX_CODES) {
+			prefix[next] = old;
+			suffix[next] = code;
+			first[next] = first[old];
+			next++;
+
+			if (next == (1 << codeSize) && codeSize < 12) codeSize++;
+		}
+
+		while (sp > 0 && written < outLength)
+			out[written++] = stack[--sp];
+
+		old = in;
+	}
+
+	return true;
+}
+
+/**
+ * Returns the row of the `index`-th stored row of an interlaced image.
+ */
+static uint32_t Deinterlace(uint32_t index, uint32_t height) {
+	static const uint32_t start[] = { 0, 4, 2, 1 }, step[] = { 8, 8, 4, 2 };
+
+	for (int pass = 0; pass < 4; pass++) {
+		uint32_t count = (height > start[pass] ? (height - start[pass] + step[pass] - 1) / step[pass] : 0);
+		if (index < count) return start[pass] + index * step[pass];
+		index -= count;
+	}
+
+	return height;
+}
+
+/**
+ * Reads a GIF frame by frame, compositing frames over a BGRA canvas.
+ * Nothing is read beyond the frame being decoded.
+ */
+class Reader {
+public:
+	Reader(const uint8_t* data, size_t length) :
+		width(0), height(0), palette(NULL), colors(0), loop(-1),
+		data(data), length(length), pos(0), transparent(-1), disposal(0), delay(0), hasPrevious(false) {}
+
+	/**
+	 * Reads the header and the global palette.
+	 */
+	bool Open(string& error) {
+		if (length < 13 || 0 != memcmp(data, "GIF8", 4)) {
+			error = "invalid gif";
+			return false;
+		}
+
+		width  = data[6] | data[7] << 8;
+		height = data[8] | data[9] << 8;
+		pos    = 13;
+
+		if (0 == width || 0 == height || size_t(width) * height > MAX_PIXELS) {
+			error = "invalid gif dimensions";
+			return false;
+		}
+
+		if (data[10] & 0x80) {
+			colors = 1 << ((data[10] & 7) + 1);
+			if (pos + colors * 3 > length) {
+				error = "truncated gif";
+				return false;
+			}
+
+			palette = data + pos;
+			pos += colors * 3;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Reads extensions up to the next frame. Returns `false` if there is none.
+	 */
+	bool Seek() {
+		while (pos < length) {
+			if (0x2c == data[pos]) return true;
+			if (0x21 != data[pos] || pos + 2 > length) return false;
+
+			uint8_t label = data[pos + 1];
+			pos += 2;
+
+			// graphic control, applies to the next frame
+			if (0xf9 == label && pos + 5 <= length && 4 == data[pos]) {
+				disposal    = (data[pos + 1] >> 2) & 7;
+				delay       = data[pos + 2] | data[pos + 3] << 8;
+				transparent = (data[pos + 1] & 1 ? data[pos + 4] : -1);
+			}
+			// loop count
+			else if (0xff == label && pos + 17 <= length && 11 == data[pos] &&
+			         0 == memcmp(data + pos + 1, "NETSCAPE2.0", 11) && 1 == data[pos + 13]) {
+				loop = data[pos + 14] | data[pos + 15] << 8;
+			}
+
+			if (!SubBlocks(NULL)) return false;
+		}
+
+		return false;
+	}
+
+	/**
+	 * Reads the descriptor of the frame `Seek` stopped at, along with the graphic control that applies to it.
+	 * Frames larger than the logical screen are rejected, those only offset past it are clipped when drawn.
+	 */
+	bool Descriptor(Frame& frame, string& error) {
+		if (pos + 11 > length) {
+			error = "truncated gif";
+			return false;
+		}
+
+		const uint8_t* d = data + pos + 1;
+		frame.x          = d[0] | d[1] << 8;
+		frame.y          = d[2] | d[3] << 8;
+		frame.width      = d[4] | d[5] << 8;
+		frame.height     = d[6] | d[7] << 8;
+		frame.interlaced = d[8] & 0x40;
+		frame.palette    = palette;
+		frame.colors     = colors;
+		pos += 10;
+
+		if (d[8] & 0x80) {
+			frame.colors = 1 << ((d[8] & 7) + 1);
+			if (pos + frame.colors * 3 > length) {
+				error = "truncated gif";
+				return false;
+			}
+
+			frame.palette = data + pos;
+			pos += frame.colors * 3;
+		}
+
+		// graphic control is consumed by the frame
+		frame.transparent = transparent;
+		frame.disposal    = disposal;
+		frame.delay       = delay;
+		transparent = -1;
+		disposal    = 0;
+		delay       = 0;
+
+		if (pos >= length || frame.width > width || frame.height > height) {
+			error = "invalid gif frame";
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Skips the frame `Seek` stopped at, without decoding it.
+	 */
+	bool Skip(Frame& frame, string& error) {
+		if (!Descriptor(frame, error)) return false;
+
+		pos++;
+		if (!SubBlocks(NULL)) pos = length;
+
+		return true;
+	}
+
+	/**
+	 * Decodes the frame `Seek` stopped at over the canvas, after disposing of the previous one.
+	 */
+	bool Next(cv::Mat& canvas, Frame& frame, string& error) {
+		if (!Descriptor(frame, error)) return false;
+
+		int minCode = data[pos++];
+
+		// a truncated last frame is decoded as far as possible
+		compressed.clear();
+		if (!SubBlocks(&compressed)) pos = length;
+
+		indices.assign(size_t(frame.width) * frame.height, frame.transparent >= 0 ? frame.transparent : 0);
+		if (!indices.empty() && !LzwDecode(compressed.data(), compressed.size(), minCode, &indices[0], indices.size())) {
+			error = "corrupted gif";
+			return false;
+		}
+
+		// previous frame disposal
+		if (hasPrevious) {
+			if (2 == previous.disposal)
+				Clear(canvas, previous);
+			else if (3 == previous.disposal)
+				Copy(canvas, previous, false);
+		}
+
+		// this frame will be restored
+		if (3 == frame.disposal) Copy(canvas, frame, true);
+
+		for (uint32_t row = 0; row < frame.height; row++) {
+			uint32_t y = frame.y + (frame.interlaced ? Deinterlace(row, frame.height) : row);
+			if (y >= uint32_t(canvas.rows)) continue;
+
+			const uint8_t* src = &indices[size_t(row) * frame.width];
+			uint8_t* dst = canvas.ptr(y);
+
+			for (uint32_t x = 0; x < frame.width && frame.x + x < uint32_t(canvas.cols); x++) {
+				int index = src[x];
+				uint8_t* p = dst + (frame.x + x) * 4;
+
+				// transparent pixels show what is below, the background keeps their color
+				bool transparentPixel = (index == frame.transparent);
+				if (transparentPixel && 0 != p[3]) continue;
+
+				if (size_t(index) < frame.colors) {
+					p[0] = frame.palette[index * 3 + 2];
+					p[1] = frame.palette[index * 3 + 1];
+					p[2] = frame.palette[index * 3];
+				}
+				else
+					p[0] = p[1] = p[2] = 0;
+				p[3] = (transparentPixel ? 0 : 255);
+			}
+		}
+
+		previous = frame;
+		hasPrevious = true;
+
+		return true;
+	}
+
+	uint32_t       width;
+	uint32_t       height;
+	const uint8_t* palette;
+	size_t         colors;
+	int            loop;
+
+private:
+	/**
+	 * Reads a sequence of data sub-blocks, up to its terminator.
+	 */
+	bool SubBlocks(vector<uint8_t>* into) {
+		while (pos < length) {
+			size_t size = data[pos++];
+			if (0 == size) return true;
+			if (pos + size > length) return false;
+
+			if (into) into->insert(into->end(), data + pos, data + pos + size);
+			pos += size;
+		}
+
+		return false;
+	}
+
+	/**
+	 * Returns the area of a frame within the canvas.
+	 */
+	static cv::Rect Area(const cv::Mat& canvas, const Frame& frame) {
+		uint32_t x0 = min<uint32_t>(frame.x, canvas.cols), y0 = min<uint32_t>(frame.y, canvas.rows);
+		uint32_t x1 = min<uint32_t>(frame.x + frame.width, canvas.cols);
+		uint32_t y1 = min<uint32_t>(frame.y + frame.height, canvas.rows);
+
+		return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+	}
+
+	/**
+	 * Restores the area of a frame to the background, which is transparent.
+	 */
+	void Clear(cv::Mat& canvas, const Frame& frame) {
+		cv::Rect area = Area(canvas, frame);
+
+		for (int y = area.y; y < area.y + area.height; y++)
+			memset(canvas.ptr(y) + area.x * 4, 0, area.width * 4);
+	}
+
+	/**
+	 * Saves or restores the area of a frame.
+	 */
+	void Copy(cv::Mat& canvas, const Frame& frame, bool save) {
+		cv::Rect area = Area(canvas, frame);
+		size_t stride = area.width * 4;
+
+		if (0 == stride) return;
+		if (save) saved.resize(stride * area.height);
+
+		for (int y = 0; y < area.height && saved.size() >= (y + 1) * stride; y++) {
+			uint8_t* row = canvas.ptr(area.y + y) + area.x * 4;
+			if (save)
+				memcpy(&saved[y * stride], row, stride);
+			else
+				memcpy(row, &saved[y * stride], stride);
+		}
+	}
+
+	const uint8_t*  data;
+	size_t          length;
+	size_t          pos;
+	int             transparent;
+	int             disposal;
+	uint32_t        delay;
+	bool            hasPrevious;
+	Frame           previous;
+	vector<uint8_t> compressed;
+	vector<uint8_t> indices;
+	vector<uint8_t> saved;
+};
+
+/**
+ * Writes a GIF, all frames sharing the global palette.
+ */
+class Writer {
+public:
+	Writer(vector<uint8_t>& out) : out(out), depth(1), keys(HASH_SIZE), codes(HASH_SIZE) {}
+
+	/**
+	 * Writes the header and the global palette, with a loop count if not negative.
+	 */
+	void Header(uint32_t width, uint32_t height, const vector<uint8_t>& palette, int loop) {
+		size_t colors = palette.size() / 3;
+
+		while ((size_t(1) << depth) < colors) depth++;
+
+		out.insert(out.end(), "GIF89a", "GIF89a" + 6);
+		Uint16(width);
+		Uint16(height);
+		out.push_back(0x80 | (depth - 1) << 4 | (depth - 1));
+		out.push_back(0);
+		out.push_back(0);
+
+		out.insert(out.end(), palette.begin(), palette.begin() + colors * 3);
+		out.resize(out.size() + ((size_t(1) << depth) - colors) * 3, 0);
+
+		if (loop >= 0) {
+			static const uint8_t netscape[] = { 0x21, 0xff, 0x0b, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+			                                    0x03, 0x01 };
+			out.insert(out.end(), netscape, netscape + sizeof(netscape));
+			Uint16(loop);
+			out.push_back(0);
+		}
+	}
+
+	/**
+	 * Writes a frame from a region of palette indices.
+	 */
+	void WriteFrame(const uint8_t* indices, size_t stride, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+	           uint32_t delay, int disposal, int transparent) {
+		// graphic control
+		out.push_back(0x21);
+		out.push_back(0xf9);
+		out.push_back(4);
+		out.push_back(disposal << 2 | (transparent >= 0 ? 1 : 0));
+		Uint16(delay);
+		out.push_back(transparent >= 0 ? transparent : 0);
+		out.push_back(0);
+
+		// image descriptor, no local palette
+		out.push_back(0x2c);
+		Uint16(x);
+		Uint16(y);
+		Uint16(width);
+		Uint16(height);
+		out.push_back(0);
+
+		Compress(indices, stride, width, height);
+	}
+
+	void Finish() {
+		out.push_back(0x3b);
+	}
+
+private:
+	void Uint16(uint32_t value) {
+		out.push_back(value & 0xff);
+		out.push_back(value >> 8 & 0xff);
+	}
+
+	/**
+	 * LZW compresses indices into data sub-blocks.
+	 */
+	void Compress(const uint8_t* indices, size_t stride, uint32_t width, uint32_t height) {
+		int minCode = max(2, depth);
+		int clear = 1 << minCode, eoi = clear + 1, next = clear + 2, codeSize = minCode + 1;
+
+		out.push_back(minCode);
+
+		bits = 0;
+		count = 0;
+		block.clear();
+		fill(keys.begin(), keys.end(), -1);
+
+		Emit(clear, codeSize);
+
+		int prefix = indices[0];
+
+		for (uint32_t y = 0; y < height; y++) {
+			const uint8_t* row = indices + y * stride;
+
+			for (uint32_t x = (0 == y ? 1 : 0); x < width; x++) {
+				int k = row[x];
+				int32_t key = prefix << 8 | k;
+				size_t h = (uint32_t(key) * 2654435761u) % HASH_SIZE;
+
+				while (-1 != keys[h] && key != keys[h])
+					h = (h + 1) % HASH_SIZE;
+
+				// known string, extend it
+				if (key == keys[h]) {
+					prefix = codes[h];
+					continue;
+				}
+
+				Emit(prefix, codeSize);
+
+				if (next < MAX_CODES) {
+					keys[h] = key;
+					codes[h] = next++;
+
+					// the decoder learns codes one code later
+					if (next > (1 << codeSize) && codeSize < 12) codeSize++;
+				}
+				else {
+					Emit(clear, codeSize);
+					fill(keys.begin(), keys.end(), -1);
+					next = clear + 2;
+					codeSize = minCode + 1;
+				}
+
+				prefix = k;
+			}
+		}
+
+		Emit(prefix, codeSize);
+
+		// the decoder learns one last code before the end
+		if (next >= (1 << codeSize) && codeSize < 12) codeSize++;
+		Emit(eoi, codeSize);
+
+		if (count > 0) Byte(bits & 0xff);
+		Flush();
+		out.push_back(0);
+	}
+
+	void Emit(int code, int codeSize) {
+		bits |= uint32_t(code) << count;
+		count += codeSize;
+
+		while (count >= 8) {
+			Byte(bits & 0xff);
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	void Byte(uint8_t byte) {
+		block.push_back(byte);
+		if (255 == block.size()) Flush();
+	}
+
+	void Flush() {
+		if (block.empty()) return;
+
+		out.push_back(block.size());
+		out.insert(out.end(), block.begin(), block.end());
+		block.clear();
+	}
+
+	vector<uint8_t>& out;
+	int              depth;
+	vector<int32_t>  keys;
+	vector<int16_t>  codes;
+	vector<uint8_t>  block;
+	uint32_t         bits;
+	int              count;
+};
+
+bool Gif::Inspect(const uint8_t* data, size_t length, Info& info, string& error) {
+	Reader reader(data, length);
+	Frame frame;
+
+	if (!reader.Open(error)) return false;
+
+	info.width       = reader.width;
+	info.height      = reader.height;
+	info.frames      = 0;
+	info.transparent = false;
+
+	while (reader.Seek()) {
+		if (!reader.Skip(frame, error)) return false;
+
+		// the background is transparent, and shows where the first frame does not cover or a frame is cleared
+		bool covers = (0 == frame.x && 0 == frame.y && frame.width >= reader.width && frame.height >= reader.height);
+		info.transparent |= (frame.transparent >= 0 || 2 == frame.disposal || (0 == info.frames && !covers));
+		info.frames++;
+	}
+
+	return true;
+}
+
+bool Gif::DecodeFirst(const uint8_t* data, size_t length, cv::Mat& out, bool& animated, string& error) {
+	Reader reader(data, length);
+	Frame frame;
+
+	if (!reader.Open(error)) return false;
+
+	if (!reader.Seek()) {
+		error = "no frame in gif";
+		return false;
+	}
+
+	cv::Mat canvas(reader.height, reader.width, CV_8UC4, cv::Scalar::all(0));
+	if (!reader.Next(canvas, frame, error)) return false;
+
+	// only extensions are read, up to the next frame
+	animated = reader.Seek();
+
+	// opaque unless some pixels are transparent or not covered
+	bool covers = (0 == frame.x && 0 == frame.y && frame.width >= reader.width && frame.height >= reader.height);
+	if (frame.transparent < 0 && covers)
+		cv::cvtColor(canvas, out, CV_BGRA2BGR);
+	else
+		out = canvas;
+
+	return true;
+}
+
+bool Gif::Encode(const cv::Mat& mat, uint32_t colors, bool dither, vector<uint8_t>& out, string& error) {
+	int channels = mat.channels();
+
+	if (CV_8U != mat.depth() || (1 != channels && 3 != channels && 4 != channels) || mat.empty()) {
+		error = "unsupported image type";
+		return false;
+	}
+
+	// one palette entry is kept for transparency, if needed
+	bool transparent = false;
+	for (int y = 0; 4 == channels && !transparent && y < mat.rows; y++) {
+		const uint8_t* row = mat.ptr(y);
+		for (int x = 0; x < mat.cols && !transparent; x++)
+			transparent = (row[x * 4 + 3] < ALPHA_THRESHOLD);
+	}
+
+	cv::Mat opaque = mat;
+	if (4 == channels) cv::cvtColor(mat, opaque, CV_BGRA2BGR);
+
+	vector<uint8_t> indices, palette, alpha;
+	uint32_t count = max<uint32_t>(2, min<uint32_t>(colors, 256) - (transparent ? 1 : 0));
+
+	if (!Palette::Quantize(opaque, count, dither, indices, palette, alpha, error)) return false;
+
+	int transparentIndex = -1;
+	if (transparent) {
+		transparentIndex = palette.size() / 3;
+		palette.resize(palette.size() + 3, 0);
+
+		for (int y = 0; y < mat.rows; y++) {
+			const uint8_t* row = mat.ptr(y);
+			for (int x = 0; x < mat.cols; x++)
+				if (row[x * 4 + 3] < ALPHA_THRESHOLD) indices[size_t(y) * mat.cols + x] = transparentIndex;
+		}
+	}
+
+	out.clear();
+
+	Writer writer(out);
+	writer.Header(mat.cols, mat.rows, palette, -1);
+	writer.WriteFrame(&indices[0], mat.cols, 0, 0, mat.cols, mat.rows, 0, 0, transparentIndex);
+	writer.Finish();
+
+	return true;
+}
+
+bool Gif::Transcode(const uint8_t* data, size_t length, const vector<Step>& steps, uint32_t colors, bool dither,
+                    vector<uint8_t>& out, uint32_t& frames, string& error, const atomic<bool>* cancelled) {
+	Reader reader(data, length);
+	Frame frame;
+	Info info;
+
+	if (!reader.Open(error) || !Inspect(data, length, info, error)) return false;
+
+	// output size
+	uint32_t width = reader.width, height = reader.height;
+
+	for (auto it = steps.begin(); it != steps.end(); it++) {
+		bool outside = it->crop && (it->x > width || it->width > width - it->x ||
+		                            it->y > height || it->height > height - it->y);
+
+		if (0 == it->width || 0 == it->height || outside) {
+			error = "invalid frame transformation";
+			return false;
+		}
+
+		width  = it->width;
+		height = it->height;
+	}
+
+	// buffers reused by every frame
+	cv::Mat canvas(reader.height, reader.width, CV_8UC4, cv::Scalar::all(0));
+	vector<cv::Mat> work(steps.size());
+	vector<uint8_t> indices(size_t(width) * height), previous(indices.size());
+	unique_ptr<Palette> mapper;
+	int transparent = -1;
+
+	Writer writer(out);
+	out.clear();
+	frames = 0;
+
+	while (reader.Seek()) {
+		if (cancelled && *cancelled) {
+			error = "cancelled";
+			return false;
+		}
+
+		if (!reader.Next(canvas, frame, error)) return false;
+
+		cv::Mat current = canvas;
+		for (size_t i = 0; i < steps.size(); i++) {
+			const Step& step = steps[i];
+
+			if (step.crop)
+				current = current(cv::Rect(step.x, step.y, step.width, step.height));
+			else {
+				cv::resize(current, work[i], cv::Size(step.width, step.height), 0, 0, cv::INTER_AREA);
+				current = work[i];
+			}
+		}
+
+		// shared palette, from the source or the first frame
+		if (0 == frames) {
+			bool needsTransparency = info.transparent;
+			vector<uint8_t> palette;
+
+			if (reader.palette && colors >= 256) {
+				for (size_t i = 0; i < reader.colors; i++) {
+					if (int(i) == frame.transparent) continue;
+					palette.insert(palette.end(), reader.palette + i * 3, reader.palette + i * 3 + 3);
+				}
+
+				if (needsTransparency) palette.resize(min<size_t>(palette.size(), 255 * 3));
+			}
+			else {
+				cv::Mat opaque;
+				vector<uint8_t> unused, alpha;
+				uint32_t count = max<uint32_t>(2, min<uint32_t>(colors, 256) - (needsTransparency ? 1 : 0));
+
+				cv::cvtColor(current, opaque, CV_BGRA2BGR);
+				if (!Palette::Quantize(opaque, count, false, unused, palette, alpha, error)) return false;
+			}
+
+			mapper.reset(new Palette(palette));
+
+			if (needsTransparency) {
+				transparent = palette.size() / 3;
+				palette.resize(palette.size() + 3, 0);
+			}
+
+			writer.Header(width, height, palette, reader.loop);
+		}
+
+		mapper->Map(current, dither, &indices[0]);
+
+		// transparent pixels can't be expressed as a difference with the previous frame, frames are written whole
+		if (transparent >= 0) {
+			for (uint32_t y = 0; y < height; y++) {
+				const uint8_t* row = current.ptr(y);
+				for (uint32_t x = 0; x < width; x++)
+					if (row[x * 4 + 3] < ALPHA_THRESHOLD) indices[size_t(y) * width + x] = transparent;
+			}
+
+			writer.WriteFrame(&indices[0], width, 0, 0, width, height, frame.delay, 2, transparent);
+		}
+		// only the area that changed is written, over the previous frame
+		else {
+			uint32_t x0 = 0, y0 = 0, x1 = width, y1 = height;
+
+			if (frames > 0) {
+				x0 = width;
+				y0 = height;
+				x1 = y1 = 0;
+
+				for (uint32_t y = 0; y < height; y++) {
+					const uint8_t* a = &indices[size_t(y) * width];
+					const uint8_t* b = &previous[size_t(y) * width];
+
+					for (uint32_t x = 0; x < width; x++) {
+						if (a[x] == b[x]) continue;
+						x0 = min(x0, x);
+						x1 = max(x1, x + 1);
+						y0 = min(y0, y);
+						y1 = max(y1, y + 1);
+					}
+				}
+
+				// nothing changed, a single pixel still carries the delay
+				if (x0 >= x1) {
+					x0 = y0 = 0;
+					x1 = y1 = 1;
+				}
+			}
+
+			writer.WriteFrame(&indices[size_t(y0) * width + x0], width, x0, y0, x1 - x0, y1 - y0, frame.delay, 1, -1);
+			indices.swap(previous);
+		}
+
+		frames++;
+	}
+
+	if (0 == frames) {
+		error = "no frame in gif";
+		return false;
+	}
+
+	writer.Finish();
+
+	return true;
+}
@@ -0,0 +1,76 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#ifndef __RIBS_GIF_H__
+#define __RIBS_GIF_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cv.h>
+
+namespace ribs {
+
+/**
+ * Direct GIF codec, for what OpenCV does not do: GIF at all, let alone animated ones.
+ */
+class Gif {
+public:
+	/**
+	 * Geometric transformation applied to each frame of an animation: a crop if `crop` is set, a resize otherwise.
+	 */
+	struct Step {
+		bool     crop;
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	/**
+	 * What is known of a GIF without decoding it.
+	 */
+	struct Info {
+		uint32_t width;
+		uint32_t height;
+		uint32_t frames;
+		bool     transparent;
+	};
+
+	/**
+	 * Walks the frames of a GIF without decoding them. `transparent` tells whether any frame may show the background
+	 * or have transparent pixels.
+	 */
+	static bool Inspect(const uint8_t* data, size_t length, Info& info, std::string& error);
+
+	/**
+	 * Decodes the first frame of a GIF, as BGR or BGRA if it is transparent, without reading further than its data.
+	 * `animated` tells whether another frame follows.
+	 */
+	static bool DecodeFirst(const uint8_t* data, size_t length, cv::Mat& out, bool& animated, std::string& error);
+
+	/**
+	 * Encodes an 8 bits image, with 1, 3 or 4 channels, to a GIF of at most `colors` colors.
+	 * Pixels of 4 channels images are either opaque or transparent, depending on their alpha value.
+	 */
+	static bool Encode(const cv::Mat& mat, uint32_t colors, bool dither, std::vector<uint8_t>& out, std::string& error);
+
+	/**
+	 * Transcodes an animated GIF, applying `steps` to each frame.
+	 *
+	 * Frames are decoded, transformed and encoded one at a time, reusing the same buffers, so that memory does not
+	 * depend on the number of frames. Frames share a single palette: the global one of the source, or one quantized
+	 * from the first frame if the source has none or `colors` is lower than 256. Delays and loop count are preserved.
+	 */
+	static bool Transcode(const uint8_t* data, size_t length, const std::vector<Step>& steps, uint32_t colors,
+	                      bool dither, std::vector<uint8_t>& out, uint32_t& frames, std::string& error,
+	                      const std::atomic<bool>* cancelled = NULL);
+};
+
+}
+
+#endif
@@ -9,6 +9,9 @@
 #include "operation/encode.h"
 #include "operation/resize.h"
 #include "operation/crop.h"
+#include "operation/jpegcrop.h"
+#include "operation/levels.h"
+#include "operation/animate.h"
 
 using namespace std;
 using namespace v8;
@@ -35,7 +38,7 @@ static inline void print_stacktrace(FILE *out = stderr, unsigned int max_frames
 
 Persistent<FunctionTemplate> Image::constructorTemplate;
 
-Image::Image(Handle<Object> wrapper) {
+Image::Image(Handle<Object> wrapper) : width(0), height(0) {
 	Wrap(wrapper);
 }
 
@@ -118,6 +121,37 @@ NAN_METHOD(Image::Decode) {
 	RIBS_OPERATION(Decode);
 }
 
+/**
+ * Creates an image from the header of an encoded one, without decoding its pixels.
+ * Returns nothing if its dimensions can't be read from its header, and for GIF whose frames are only known by decoding.
+ */
+NAN_METHOD(Image::Probe) {
+	NanScope();
+
+	if (!Buffer::HasInstance(args[0])) return ThrowException(Exception::Error(String::New("invalid input buffer")));
+
+	auto data   = reinterpret_cast<pixel_t*>(Buffer::Data(args[0]->ToObject()));
+	auto length = Buffer::Length(args[0]->ToObject());
+	auto format = SourceFormat(data, length);
+	uint32_t width, height;
+
+	if ("gif" == format || !SourceDimensions(format, data, length, width, height) || 0 == width || 0 == height)
+		NanReturnValue(Undefined());
+
+	Local<Object> instance = constructorTemplate->GetFunction()->NewInstance();
+	auto image = Unwrap<Image>(instance);
+
+	image->width = width;
+	image->height = height;
+	image->originalFormat = format;
+
+	NanReturnValue(instance);
+}
+
+NAN_METHOD(Image::Load) {
+	RIBS_OPERATION(Load);
+}
+
 NAN_METHOD(Image::Encode) {
 	RIBS_OPERATION(Encode);
 }
@@ -130,6 +164,39 @@ NAN_METHOD(Image::Crop) {
 	RIBS_OPERATION(Crop);
 }
 
+NAN_METHOD(Image::Levels) {
+	RIBS_OPERATION(Levels);
+}
+
+NAN_METHOD(Image::CropJpeg) {
+	RIBS_OPERATION(JpegCrop);
+}
+
+/**
+ * Returns the MCU size of a JPEG image as `{ width, height }`, nothing if its start of frame can't be found.
+ */
+NAN_METHOD(Image::JpegBlockSize) {
+	NanScope();
+
+	if (!Buffer::HasInstance(args[0])) return ThrowException(Exception::Error(String::New("invalid input buffer")));
+
+	auto data   = reinterpret_cast<pixel_t*>(Buffer::Data(args[0]->ToObject()));
+	auto length = Buffer::Length(args[0]->ToObject());
+	uint32_t width, height;
+
+	if (!ribs::JpegBlockSize(data, length, width, height)) NanReturnValue(Undefined());
+
+	Local<Object> size = Object::New();
+	size->Set(NanSymbol("width"), Number::New(width));
+	size->Set(NanSymbol("height"), Number::New(height));
+
+	NanReturnValue(size);
+}
+
+NAN_METHOD(Image::Animate) {
+	RIBS_OPERATION(Animate);
+}
+
 void Image::Initialize(Handle<Object> target) {
 	// constructor
 	Local<FunctionTemplate> t = FunctionTemplate::New(New);
@@ -144,12 +211,18 @@ void Image::Initialize(Handle<Object> target) {
 	prototype->SetAccessor(NanSymbol("channels"), GetChannels);
 	prototype->SetAccessor(NanSymbol("originalFormat"), GetOriginalFormat);
 	prototype->SetAccessor(NanSymbol("length"), GetLength);
+	NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "load", Load);
 	NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "encode", Encode);
 	NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "resize", Resize);
 	NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "crop", Crop);
+	NODE_SET_PROTOTYPE_METHOD(constructorTemplate, "levels", Levels);
 
 	// object
 	NODE_SET_METHOD(constructorTemplate->GetFunction(), "decode", Decode);
+	NODE_SET_METHOD(constructorTemplate->GetFunction(), "probe", Probe);
+	NODE_SET_METHOD(constructorTemplate->GetFunction(), "cropJpeg", CropJpeg);
+	NODE_SET_METHOD(constructorTemplate->GetFunction(), "jpegBlockSize", JpegBlockSize);
+	NODE_SET_METHOD(constructorTemplate->GetFunction(), "animate", Animate);
 
 	// export
 	target->Set(NanSymbol("Image"), constructorTemplate->GetFunction());
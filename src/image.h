@@ -18,8 +18,8 @@ public:
 	static v8::Local<v8::Object> New(cv::Mat& mat, const std::string& format);
 
 	inline pixel_t*    Pixels()         const { return mat.data; }
-	inline uint32_t    Width()          const { return mat.size().width; }
-	inline uint32_t    Height()         const { return mat.size().height; }
+	inline uint32_t    Width()          const { return mat.empty() ? width : mat.size().width; }
+	inline uint32_t    Height()         const { return mat.empty() ? height : mat.size().height; }
 	inline int         Length()         const { return mat.total() * Channels(); }
 	inline int         Channels()       const { return mat.channels(); }
 	inline std::string OriginalFormat() const { return originalFormat; }
@@ -40,12 +40,22 @@ private:
 	static NAN_GETTER(GetLength);
 
 	static NAN_METHOD(Decode);
+	static NAN_METHOD(Probe);
+	static NAN_METHOD(Load);
 	static NAN_METHOD(Encode);
 	static NAN_METHOD(Resize);
 	static NAN_METHOD(Crop);
+	static NAN_METHOD(Levels);
+	static NAN_METHOD(CropJpeg);
+	static NAN_METHOD(JpegBlockSize);
+	static NAN_METHOD(Animate);
 
 	cv::Mat mat;
 	std::string originalFormat;
+
+	// dimensions read from the header of a probed image, until its pixels are loaded
+	uint32_t width;
+	uint32_t height;
 };
 
 }
@@ -5,6 +5,8 @@
  */
 
 #include "image.h"
+#include "operation.h"
+#include "operation/sendfile.h"
 
 using namespace v8;
 using namespace ribs;
@@ -18,6 +20,8 @@ extern "C" void init(Handle<Object> target) {
 	NanScope();
 
 	Image::Initialize(target);
+	Operation::Initialize(target);
+	NODE_SET_METHOD(target, "sendfile", Sendfile);
 
 	// mute OCV errors, let us handle those
 	//   http://stackoverflow.com/questions/2182235/error-modes-for-opencv
@@ -0,0 +1,356 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#include "jpeg.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csetjmp>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+using namespace std;
+using namespace ribs;
+
+/**
+ * libjpeg calls `exit()` on errors by default, jump back to the caller instead.
+ */
+struct ErrorManager {
+	jpeg_error_mgr pub;
+	jmp_buf        jump;
+	char           message[JMSG_LENGTH_MAX];
+};
+
+static void OnError(j_common_ptr cinfo) {
+	auto manager = reinterpret_cast<ErrorManager*>(cinfo->err);
+	(*cinfo->err->format_message)(cinfo, manager->message);
+	longjmp(manager->jump, 1);
+}
+
+static void OnMessage(j_common_ptr cinfo) {
+	// mute warnings
+}
+
+static jpeg_error_mgr* ErrorManagerInit(ErrorManager* manager) {
+	jpeg_std_error(&manager->pub);
+	manager->pub.error_exit = OnError;
+	manager->pub.output_message = OnMessage;
+	manager->message[0] = '\0';
+	return &manager->pub;
+}
+
+static bool IsMarker(jpeg_saved_marker_ptr marker, int code, const char* name) {
+	size_t length = strlen(name) + 1;
+	return (code == marker->marker && marker->data_length >= length && 0 == memcmp(marker->data, name, length));
+}
+
+bool Jpeg::Crop(const uint8_t* data, size_t length, uint32_t width, uint32_t height, uint32_t x, uint32_t y,
+                vector<uint8_t>& out, string& error) {
+	jpeg_decompress_struct src;
+	jpeg_compress_struct   dst;
+	ErrorManager           manager;
+	unsigned char*         outBuffer = NULL;
+	unsigned long          outSize = 0;
+
+	src.err = ErrorManagerInit(&manager);
+	dst.err = &manager.pub;
+	jpeg_create_decompress(&src);
+	jpeg_create_compress(&dst);
+
+	if (setjmp(manager.jump)) {
+		error = manager.message;
+		jpeg_destroy_compress(&dst);
+		jpeg_destroy_decompress(&src);
+		free(outBuffer);
+		return false;
+	}
+
+	jpeg_mem_src(&src, const_cast<unsigned char*>(data), length);
+
+	// keep comments and application markers (EXIF, ICC, ...)
+	jpeg_save_markers(&src, JPEG_COM, 0xffff);
+	for (int m = 0; m < 16; m++)
+		jpeg_save_markers(&src, JPEG_APP0 + m, 0xffff);
+
+	jpeg_read_header(&src, TRUE);
+
+	// region must fit in the image
+	if (0 == width || 0 == height || x + width > src.image_width || y + height > src.image_height) {
+		jpeg_destroy_compress(&dst);
+		jpeg_destroy_decompress(&src);
+		error = "invalid crop region";
+		return false;
+	}
+
+	// snap origin to the MCU grid
+	uint32_t mcuWidth  = src.max_h_samp_factor * DCTSIZE;
+	uint32_t mcuHeight = src.max_v_samp_factor * DCTSIZE;
+	uint32_t mcuX      = x / mcuWidth;
+	uint32_t mcuY      = y / mcuHeight;
+	uint32_t mcuCols   = (width + mcuWidth - 1) / mcuWidth;
+	uint32_t mcuRows   = (height + mcuHeight - 1) / mcuHeight;
+
+	// coefficient arrays of the cropped image.
+	// those must be requested before reading source coefficients, so that libjpeg realizes them along.
+	auto dstCoefs = static_cast<jvirt_barray_ptr*>((*src.mem->alloc_small)(
+		(j_common_ptr)&src, JPOOL_IMAGE, sizeof(jvirt_barray_ptr) * src.num_components
+	));
+
+	for (int ci = 0; ci < src.num_components; ci++) {
+		jpeg_component_info* comp = src.comp_info + ci;
+		dstCoefs[ci] = (*src.mem->request_virt_barray)(
+			(j_common_ptr)&src, JPOOL_IMAGE, FALSE,
+			mcuCols * comp->h_samp_factor, mcuRows * comp->v_samp_factor, comp->v_samp_factor
+		);
+	}
+
+	jvirt_barray_ptr* srcCoefs = jpeg_read_coefficients(&src);
+
+	// copy blocks of the region, one MCU row at a time
+	for (int ci = 0; ci < src.num_components; ci++) {
+		jpeg_component_info* comp = src.comp_info + ci;
+		JDIMENSION hSamp = comp->h_samp_factor;
+		JDIMENSION vSamp = comp->v_samp_factor;
+		JDIMENSION blocksX = mcuX * hSamp;
+		JDIMENSION blocksY = mcuY * vSamp;
+		JDIMENSION blocksWidth = mcuCols * hSamp;
+		JDIMENSION blocksHeight = mcuRows * vSamp;
+
+		for (JDIMENSION row = 0; row < blocksHeight; row += vSamp) {
+			JBLOCKARRAY dstRows = (*src.mem->access_virt_barray)((j_common_ptr)&src, dstCoefs[ci], row, vSamp, TRUE);
+			JBLOCKARRAY srcRows = (*src.mem->access_virt_barray)((j_common_ptr)&src, srcCoefs[ci], row + blocksY, vSamp, FALSE);
+
+			for (JDIMENSION i = 0; i < vSamp; i++)
+				memcpy(dstRows[i], srcRows[i] + blocksX, blocksWidth * sizeof(JBLOCK));
+		}
+	}
+
+	// write cropped coefficients, with the same tables than the source
+	jpeg_mem_dest(&dst, &outBuffer, &outSize);
+	jpeg_copy_critical_parameters(&src, &dst);
+	dst.image_width = width;
+	dst.image_height = height;
+	if (src.progressive_mode)
+		jpeg_simple_progression(&dst);
+
+	jpeg_write_coefficients(&dst, dstCoefs);
+
+	// copy markers, except JFIF and Adobe ones that are written by libjpeg itself
+	for (jpeg_saved_marker_ptr marker = src.marker_list; marker; marker = marker->next) {
+		if (dst.write_JFIF_header && IsMarker(marker, JPEG_APP0, "JFIF")) continue;
+		if (dst.write_Adobe_marker && IsMarker(marker, JPEG_APP0 + 14, "Adobe")) continue;
+		jpeg_write_marker(&dst, marker->marker, marker->data, marker->data_length);
+	}
+
+	jpeg_finish_compress(&dst);
+	jpeg_finish_decompress(&src);
+
+	out.assign(outBuffer, outBuffer + outSize);
+
+	jpeg_destroy_compress(&dst);
+	jpeg_destroy_decompress(&src);
+	free(outBuffer);
+
+	return true;
+}
+
+/**
+ * YCbCr 4:2:0 planes of an image, padded to the MCU grid by edge replication.
+ * Grayscale images only have the luma plane.
+ */
+struct Planes {
+	uint32_t width;
+	uint32_t height;
+	cv::Mat  y;
+	cv::Mat  cb;
+	cv::Mat  cr;
+};
+
+static void PreparePlanes(const cv::Mat& mat, Planes& planes) {
+	uint32_t width  = (mat.cols + 2 * DCTSIZE - 1) & ~(2 * DCTSIZE - 1);
+	uint32_t height = (mat.rows + 2 * DCTSIZE - 1) & ~(2 * DCTSIZE - 1);
+
+	planes.width = mat.cols;
+	planes.height = mat.rows;
+
+	// grayscale, luma only
+	if (1 == mat.channels()) {
+		cv::copyMakeBorder(mat, planes.y, 0, height - mat.rows, 0, width - mat.cols, cv::BORDER_REPLICATE);
+		return;
+	}
+
+	cv::Mat bgr, ycrcb;
+	vector<cv::Mat> channels;
+
+	// JPEG has no alpha
+	if (4 == mat.channels())
+		cv::cvtColor(mat, bgr, CV_BGRA2BGR);
+	else
+		bgr = mat;
+
+	cv::copyMakeBorder(bgr, ycrcb, 0, height - mat.rows, 0, width - mat.cols, cv::BORDER_REPLICATE);
+	cv::cvtColor(ycrcb, ycrcb, CV_BGR2YCrCb);
+	cv::split(ycrcb, channels);
+
+	// OCV uses the same full range BT.601 transform than JFIF, only the order of chroma differs
+	planes.y = channels[0];
+	cv::resize(channels[2], planes.cb, cv::Size(width / 2, height / 2), 0, 0, cv::INTER_AREA);
+	cv::resize(channels[1], planes.cr, cv::Size(width / 2, height / 2), 0, 0, cv::INTER_AREA);
+}
+
+static bool Compress(const Planes& planes, int quality, vector<uint8_t>& out, string& error) {
+	jpeg_compress_struct cinfo;
+	ErrorManager         manager;
+	unsigned char*       outBuffer = NULL;
+	unsigned long        outSize = 0;
+	bool                 gray = planes.cb.empty();
+
+	cinfo.err = ErrorManagerInit(&manager);
+	jpeg_create_compress(&cinfo);
+
+	if (setjmp(manager.jump)) {
+		error = manager.message;
+		jpeg_destroy_compress(&cinfo);
+		free(outBuffer);
+		return false;
+	}
+
+	jpeg_mem_dest(&cinfo, &outBuffer, &outSize);
+
+	cinfo.image_width = planes.width;
+	cinfo.image_height = planes.height;
+	cinfo.input_components = gray ? 1 : 3;
+	cinfo.in_color_space = gray ? JCS_GRAYSCALE : JCS_YCbCr;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, quality, TRUE);
+
+	// planes are already converted and downsampled
+	cinfo.raw_data_in = TRUE;
+	cinfo.optimize_coding = TRUE;
+	if (!gray) {
+		cinfo.comp_info[0].h_samp_factor = cinfo.comp_info[0].v_samp_factor = 2;
+		cinfo.comp_info[1].h_samp_factor = cinfo.comp_info[1].v_samp_factor = 1;
+		cinfo.comp_info[2].h_samp_factor = cinfo.comp_info[2].v_samp_factor = 1;
+	}
+
+	jpeg_start_compress(&cinfo, TRUE);
+
+	// one MCU row at a time
+	JDIMENSION rows = (gray ? DCTSIZE : 2 * DCTSIZE);
+	JSAMPROW   yRows[2 * DCTSIZE], cbRows[DCTSIZE], crRows[DCTSIZE];
+	JSAMPARRAY data[3] = { yRows, cbRows, crRows };
+
+	while (cinfo.next_scanline < cinfo.image_height) {
+		JDIMENSION row = cinfo.next_scanline;
+
+		for (JDIMENSION i = 0; i < rows; i++)
+			yRows[i] = const_cast<uchar*>(planes.y.ptr(row + i));
+
+		for (JDIMENSION i = 0; !gray && i < DCTSIZE; i++) {
+			cbRows[i] = const_cast<uchar*>(planes.cb.ptr(row / 2 + i));
+			crRows[i] = const_cast<uchar*>(planes.cr.ptr(row / 2 + i));
+		}
+
+		jpeg_write_raw_data(&cinfo, data, rows);
+	}
+
+	jpeg_finish_compress(&cinfo);
+
+	out.assign(outBuffer, outBuffer + outSize);
+
+	jpeg_destroy_compress(&cinfo);
+	free(outBuffer);
+
+	return true;
+}
+
+bool Jpeg::EncodeBudget(const cv::Mat& mat, size_t maxBytes, int minQuality, int maxQuality, int maxTrials,
+                        vector<uint8_t>& out, int& quality, int& trials, string& error,
+                        const atomic<bool>* cancelled) {
+	if (CV_8U != mat.depth() || (1 != mat.channels() && 3 != mat.channels() && 4 != mat.channels())) {
+		error = "unsupported image type";
+		return false;
+	}
+
+	minQuality = max(1, min(minQuality, 100));
+	maxQuality = max(minQuality, min(maxQuality, 100));
+	maxTrials  = max(1, maxTrials);
+
+	Planes          planes;
+	vector<uint8_t> data;
+
+	PreparePlanes(mat, planes);
+	trials = 0;
+
+	// best case, the highest quality already fits.
+	// `out` always holds the best output so far: the highest quality that fits, or the smallest one.
+	trials++;
+	if (!Compress(planes, maxQuality, out, error)) return false;
+	quality = maxQuality;
+
+	if (out.size() <= maxBytes || trials >= maxTrials || minQuality == maxQuality) return true;
+
+	int    hi = maxQuality;
+	size_t hiSize = out.size();
+
+	if (cancelled && *cancelled) {
+		error = "cancelled";
+		return false;
+	}
+
+	// worst case, even the lowest quality is too large
+	trials++;
+	if (!Compress(planes, minQuality, data, error)) return false;
+	out.swap(data);
+	quality = minQuality;
+
+	if (out.size() > maxBytes) return true;
+
+	int    lo = minQuality;
+	size_t loSize = out.size();
+	bool   bisect = false;
+
+	// size grows roughly linearly with quality on small intervals, interpolate between bounds.
+	// when an interpolation does not halve the interval, bisect next to guarantee convergence.
+	while (trials < maxTrials && hi - lo > 1) {
+		int span = hi - lo;
+		int q;
+
+		if (cancelled && *cancelled) {
+			error = "cancelled";
+			return false;
+		}
+
+		if (bisect || hiSize <= loSize)
+			q = lo + span / 2;
+		else
+			q = lo + static_cast<int>(static_cast<double>(maxBytes - loSize) * span / (hiSize - loSize));
+
+		q = max(lo + 1, min(q, hi - 1));
+
+		trials++;
+		if (!Compress(planes, q, data, error)) return false;
+
+		if (data.size() <= maxBytes) {
+			lo = q;
+			loSize = data.size();
+			out.swap(data);
+			quality = q;
+		}
+		else {
+			hi = q;
+			hiSize = data.size();
+		}
+
+		bisect = (hi - lo) * 2 > span;
+	}
+
+	return true;
+}
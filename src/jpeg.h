@@ -0,0 +1,49 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#ifndef __RIBS_JPEG_H__
+#define __RIBS_JPEG_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cv.h>
+
+namespace ribs {
+
+/**
+ * Direct libjpeg helpers, for what OpenCV does not expose.
+ */
+class Jpeg {
+public:
+	/**
+	 * Crops a JPEG image without decoding it, like `jpegtran -crop` does.
+	 * DCT coefficients of the region are copied as is, so there is no quality loss.
+	 *
+	 * `x` and `y` must be multiples of the MCU size, they are rounded down otherwise.
+	 */
+	static bool Crop(const uint8_t* data, size_t length, uint32_t width, uint32_t height, uint32_t x, uint32_t y,
+	                 std::vector<uint8_t>& out, std::string& error);
+
+	/**
+	 * Encodes an image with the best quality whose output fits in `maxBytes`.
+	 *
+	 * Color conversion and chroma downsampling are done once, then each trial only compresses those planes again
+	 * (libjpeg raw data mode). Quality is searched in `[minQuality, maxQuality]` by interpolation, falling back to
+	 * bisection when it converges slowly, in at most `maxTrials` compressions.
+	 * If even `minQuality` does not fit, its output is given anyway.
+	 *
+	 * `cancelled` is checked between trials, the search fails with a `cancelled` error if it gets set.
+	 */
+	static bool EncodeBudget(const cv::Mat& mat, size_t maxBytes, int minQuality, int maxQuality, int maxTrials,
+	                         std::vector<uint8_t>& out, int& quality, int& trials, std::string& error,
+	                         const std::atomic<bool>* cancelled = NULL);
+};
+
+}
+
+#endif
@@ -6,40 +6,105 @@
 
 #include "operation.h"
 
+using namespace std;
 using namespace v8;
 using namespace node;
 using namespace ribs;
 
+/**
+ * Default inline threshold, roughly a 100x100 RGB image.
+ */
+size_t             Operation::inlineThreshold = 100 * 100 * 3;
+uint32_t           Operation::inlineCount     = 0;
+uint32_t           Operation::queuedCount     = 0;
+vector<Operation*> Operation::inlineQueue;
+uv_idle_t          Operation::inlineHandle;
+uint32_t           Operation::lastId          = 0;
+map<uint32_t, Operation*> Operation::pending;
+
 Operation::Operation(_NAN_METHOD_ARGS) {
 	// assign callback
 	callback = new NanCallback(args[args.Length() - 1].As<Function>());
 
 	// reference this operation
 	req.data = this;
+
+	// track it until completion, so it can be cancelled
+	id = ++lastId;
+	queued = false;
+	cancelled = false;
+	pending[id] = this;
 }
 
 Operation::~Operation() {
+	pending.erase(id);
 	delete callback;
 }
 
+bool Operation::Aborted() {
+	if (cancelled) error = "operation cancelled";
+	return cancelled;
+}
+
 void Operation::Enqueue() {
+	// tiny operation, process it right away.
+	// the callback is still deferred to the next loop iteration, so that it's always asynchronous.
+	if (Cost() < inlineThreshold) {
+		inlineCount++;
+		Process();
+
+		inlineQueue.push_back(this);
+		uv_idle_start(&inlineHandle, (uv_idle_cb)AfterProcessInline);
+		return;
+	}
+
 	// here we go!
+	queuedCount++;
+	queued = true;
 	uv_queue_work(uv_default_loop(), &req, ProcessAsync, (uv_after_work_cb)AfterProcessAsync);
 }
 
 void Operation::ProcessAsync(uv_work_t* req) {
 	auto op = static_cast<Operation*>(req->data);
+
+	// cancelled while being picked up by a thread
+	if (op->Aborted()) return;
+
 	op->Process();
 }
 
-void Operation::AfterProcessAsync(uv_work_t* req) {
-	NanScope();
-
+void Operation::AfterProcessAsync(uv_work_t* req, int status) {
 	auto op = static_cast<Operation*>(req->data);
 
+	// cancelled before reaching a thread, `Process` never ran
+	if (0 != status) {
+		op->cancelled = true;
+		op->Aborted();
+	}
+
+	Complete(op);
+}
+
+void Operation::AfterProcessInline(uv_idle_t* handle) {
+	uv_idle_stop(handle);
+
+	// callbacks may enqueue new inline operations, swap the queue before completing
+	vector<Operation*> ops;
+	ops.swap(inlineQueue);
+
+	for (auto it = ops.begin(); it != ops.end(); it++)
+		Complete(*it);
+}
+
+void Operation::Complete(Operation* op) {
+	NanScope();
+
 	int argc = 0;
 	Local<Value> argv[2];
 
+	// cancelled after its last check, or while doing work that can't be interrupted: output is discarded
+	if (op->error.empty()) op->Aborted();
+
 	// execute callback with error.
 	// note that we explicitly pass undefined to the 2nd argument.
 	// this is to respect the arity of the function and allow curry for example.
@@ -64,4 +129,60 @@ void Operation::AfterProcessAsync(uv_work_t* req) {
 	if (tryCatch.HasCaught()) {
 		FatalException(tryCatch);
 	}
-}
\ No newline at end of file
+}
+
+/**
+ * Gets or sets the inline threshold, in bytes. `0` disables the inline path.
+ */
+NAN_METHOD(Operation::InlineThreshold) {
+	NanScope();
+
+	if (args.Length() > 0)
+		inlineThreshold = args[0]->Uint32Value();
+
+	NanReturnValue(Number::New(inlineThreshold));
+}
+
+/**
+ * Returns how many operations were processed inline and in the thread pool.
+ */
+NAN_METHOD(Operation::Stats) {
+	NanScope();
+
+	Local<Object> stats = Object::New();
+	stats->Set(NanSymbol("inline"), Number::New(inlineCount));
+	stats->Set(NanSymbol("queued"), Number::New(queuedCount));
+
+	NanReturnValue(stats);
+}
+
+/**
+ * Cancels an operation by id.
+ * A queued operation is removed from the thread pool queue. A running one stops at its next check: between bands of
+ * rows when sharpening or writing PNG, between trials of the JPEG budget search and between frames of an animation.
+ * Other work, like decoding or resampling, is done in one go by OpenCV and runs to its end. Either way, its callback
+ * gets an `operation cancelled` error and its output is discarded.
+ * Returns `false` if the operation is already completed or can't be cancelled anymore.
+ */
+NAN_METHOD(Operation::Cancel) {
+	NanScope();
+
+	auto it = pending.find(args[0]->Uint32Value());
+
+	// inline operations are already processed
+	if (pending.end() == it || !it->second->queued) NanReturnValue(False());
+
+	Operation* op = it->second;
+	op->cancelled = true;
+	uv_cancel(reinterpret_cast<uv_req_t*>(&op->req));
+
+	NanReturnValue(True());
+}
+
+void Operation::Initialize(Handle<Object> target) {
+	uv_idle_init(uv_default_loop(), &inlineHandle);
+
+	NODE_SET_METHOD(target, "inlineThreshold", InlineThreshold);
+	NODE_SET_METHOD(target, "stats", Stats);
+	NODE_SET_METHOD(target, "cancel", Cancel);
+}
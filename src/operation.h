@@ -9,6 +9,10 @@
 
 #include "common.h"
 
+#include <atomic>
+#include <cstdint>
+#include <map>
+
 namespace ribs {
 
 /**
@@ -18,8 +22,25 @@ namespace ribs {
  */
 class Operation {
 public:
+	static void Initialize(v8::Handle<v8::Object> target);
+
 	void Enqueue();
 
+	/**
+	 * Identifier of the operation, given to JavaScript so that it can be cancelled.
+	 */
+	uint32_t Id() const { return id; }
+
+	/**
+	 * Size in bytes of an image, saturating instead of wrapping around.
+	 * Dimensions may come from a forged header, a huge image must never look cheap.
+	 */
+	static size_t Bytes(size_t width, size_t height, size_t channels, size_t factor = 1) {
+		if (0 == width || 0 == height || 0 == channels || 0 == factor) return 0;
+		if (width > SIZE_MAX / height / channels / factor) return SIZE_MAX;
+		return width * height * channels * factor;
+	}
+
 	Operation(_NAN_METHOD_ARGS);
 	virtual ~Operation();
 
@@ -39,12 +60,43 @@ protected:
 	 */
 	virtual v8::Local<v8::Value> OutputValue() = 0;
 
-	std::string  error;
-	NanCallback* callback;
-	uv_work_t    req;
+	/**
+	 * Return an estimation of the amount of work of the operation, in bytes of pixels to process.
+	 * Operations cheaper than the inline threshold are processed on the calling thread, as the thread pool hop would
+	 * cost more than the work itself.
+	 */
+	virtual size_t Cost() = 0;
+
+	/**
+	 * Tells whether the operation has been cancelled, setting the error if so.
+	 * Long running operations check it between row bands and bail out before committing any output.
+	 */
+	bool Aborted();
+
+	std::string       error;
+	NanCallback*      callback;
+	uv_work_t         req;
+	uint32_t          id;
+	bool              queued;
+	std::atomic<bool> cancelled;
 
 	static void ProcessAsync(uv_work_t* req);
-	static void AfterProcessAsync(uv_work_t* req);
+	static void AfterProcessAsync(uv_work_t* req, int status);
+	static void AfterProcessInline(uv_idle_t* handle);
+	static void Complete(Operation* op);
+
+private:
+	static NAN_METHOD(InlineThreshold);
+	static NAN_METHOD(Stats);
+	static NAN_METHOD(Cancel);
+
+	static size_t                  inlineThreshold;
+	static uint32_t                inlineCount;
+	static uint32_t                queuedCount;
+	static std::vector<Operation*> inlineQueue;
+	static uv_idle_t               inlineHandle;
+	static uint32_t                lastId;
+	static std::map<uint32_t, Operation*> pending;
 };
 
 /**
@@ -63,6 +115,7 @@ protected:
 	private:                                  \
 		void                 Process();       \
 		v8::Local<v8::Value> OutputValue();   \
+		size_t               Cost();          \
 		stub                                  \
 	};
 
@@ -70,6 +123,7 @@ protected:
 #define OPERATION_CLEANUP(name, stub) _OP_METHOD(name, ~_OP_NAME(name), , void, stub)
 #define OPERATION_PROCESS(name, stub) _OP_METHOD(name, Process, void, void, stub)
 #define OPERATION_VALUE(name, stub)   _OP_METHOD(name, OutputValue, Local<Value>, void, stub)
+#define OPERATION_COST(name, stub)    _OP_METHOD(name, Cost, size_t, void, stub)
 
 #define RIBS_OPERATION(name)                                             \
 	NanScope();                                                          \
@@ -80,8 +134,9 @@ protected:
 	catch (const std::exception& e) {                                    \
 		return ThrowException(Exception::Error(String::New(e.what())));  \
 	}                                                                    \
+	uint32_t id = op->Id();                                              \
 	op->Enqueue();                                                       \
-	NanReturnUndefined();
+	NanReturnValue(Number::New(id));
 
 }
 
@@ -0,0 +1,91 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#include "animate.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+using namespace ribs;
+
+OPERATION_PREPARE(Animate, {
+	// check against mandatory buffer input
+	if (!Buffer::HasInstance(args[0])) throw invalid_argument("invalid input buffer");
+	if (!args[1]->IsArray()) throw invalid_argument("invalid steps");
+
+	// create a persistent object during the process to avoid v8 to dispose the buffer.
+	NanAssignPersistent(Object, bufferHandle, args[0]->ToObject());
+
+	data   = reinterpret_cast<pixel_t*>(Buffer::Data(args[0]->ToObject()));
+	length = Buffer::Length(args[0]->ToObject());
+
+	// transformations to apply to each frame, in order
+	Local<Array> array = args[1].As<Array>();
+	for (uint32_t i = 0; i < array->Length(); i++) {
+		Local<Object> object = array->Get(i)->ToObject();
+		Gif::Step step;
+
+		step.crop   = object->Get(NanSymbol("crop"))->BooleanValue();
+		step.x      = object->Get(NanSymbol("x"))->Uint32Value();
+		step.y      = object->Get(NanSymbol("y"))->Uint32Value();
+		step.width  = object->Get(NanSymbol("width"))->Uint32Value();
+		step.height = object->Get(NanSymbol("height"))->Uint32Value();
+		steps.push_back(step);
+	}
+
+	// palette
+	colors = 256;
+	dither = false;
+	frames = 0;
+
+	if (args.Length() > 3 && args[2]->IsObject()) {
+		Local<Object> options = args[2].As<Object>();
+		Local<Value>  value;
+
+		if ((value = options->Get(NanSymbol("colors")))->IsNumber())
+			colors = value->Uint32Value();
+		dither = options->Get(NanSymbol("dither"))->BooleanValue();
+
+		if (colors < 2 || colors > 256) throw invalid_argument("colors must be between 2 and 256");
+	}
+})
+
+OPERATION_CLEANUP(Animate, {
+	if (!bufferHandle.IsEmpty()) NanDisposePersistent(bufferHandle);
+})
+
+OPERATION_PROCESS(Animate, {
+	string reason;
+
+	// frames are decoded, transformed and encoded one at a time
+	if (!Gif::Transcode(data, length, steps, colors, dither, outVec, frames, reason, &cancelled)) {
+		if (Aborted()) return;
+		error = "operation error: animate: " + reason;
+	}
+})
+
+OPERATION_VALUE(Animate, {
+	Local<Object> buffer = NanNewBufferHandle(reinterpret_cast<char*>(&outVec[0]), outVec.size());
+
+	buffer->Set(NanSymbol("frames"), Number::New(frames));
+
+	return buffer;
+})
+
+OPERATION_COST(Animate, {
+	Gif::Info info;
+	string    reason;
+
+	// unreadable gifs fail fast, but still off the event loop
+	if (!Gif::Inspect(data, length, info, reason)) return SIZE_MAX;
+
+	// every frame is composited on the logical screen, then goes through each step, whatever its compressed size
+	size_t frame = Operation::Bytes(info.width, info.height, 4);
+	for (auto it = steps.begin(); it != steps.end(); it++)
+		frame = min(SIZE_MAX - frame, Operation::Bytes(it->width, it->height, 4)) + frame;
+
+	return Operation::Bytes(frame, 1, 1, max<uint32_t>(info.frames, 1));
+})
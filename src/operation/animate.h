@@ -0,0 +1,28 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#ifndef __RIBS_OPERATION_ANIMATE_H__
+#define __RIBS_OPERATION_ANIMATE_H__
+
+#include "../operation.h"
+#include "../gif.h"
+
+namespace ribs {
+
+OPERATION(Animate,
+	v8::Persistent<v8::Object> bufferHandle;
+	pixel_t*               data;
+	size_t                 length;
+	std::vector<Gif::Step> steps;
+	uint32_t               colors;
+	bool                   dither;
+	uint32_t               frames;
+	std::vector<uint8_t>   outVec;
+);
+
+}
+
+#endif
@@ -46,3 +46,7 @@ OPERATION_VALUE(Crop, {
 	image->Sync(imageHandle);
 	return NanPersistentToLocal(imageHandle);
 })
+
+OPERATION_COST(Crop, {
+	return Bytes(width, height, image->Channels());
+})
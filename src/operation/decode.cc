@@ -5,6 +5,7 @@
  */
 
 #include "decode.h"
+#include "../gif.h"
 #include "../image.h"
 
 using namespace std;
@@ -12,7 +13,8 @@ using namespace v8;
 using namespace node;
 using namespace ribs;
 
-static string Format(pixel_t* data);
+static bool   DecodePixels(const string& format, const cv::Mat& inMat, cv::Mat& outMat, bool& animated, string& error);
+static size_t EstimateCost(const string& format, const cv::Mat& inMat);
 
 OPERATION_PREPARE(Decode, {
 	// check against mandatory buffer input
@@ -25,14 +27,95 @@ OPERATION_PREPARE(Decode, {
 	auto length = Buffer::Length(args[0]->ToObject());
 
 	// store input format
-	inFormat = Format(buffer);
+	inFormat = SourceFormat(buffer, length);
 
 	inMat = cv::Mat(length, 1, CV_8UC1, buffer);
+
+	animated = false;
 })
 
 OPERATION_CLEANUP(Decode, {})
 
 OPERATION_PROCESS(Decode, {
+	DecodePixels(inFormat, inMat, outMat, animated, error);
+
+	// pixels are decoded in one go, at least release them right away if cancelled meanwhile
+	if (Aborted()) outMat.release();
+})
+
+OPERATION_VALUE(Decode, {
+	Local<Object> instance = Image::New(outMat, inFormat);
+
+	// let JavaScript know the source has to be transcoded to keep its frames
+	if ("gif" == inFormat) instance->Set(NanSymbol("animated"), Boolean::New(animated));
+
+	return instance;
+})
+
+OPERATION_COST(Decode, {
+	return EstimateCost(inFormat, inMat);
+})
+
+OPERATION_PREPARE(Load, {
+	// check against mandatory image input (from this) and buffer input
+	image = ObjectWrap::Unwrap<Image>(args.This());
+	if (!Buffer::HasInstance(args[0])) throw invalid_argument("invalid input buffer");
+
+	// create persistent objects during the process to avoid v8 to dispose the image and the buffer.
+	NanAssignPersistent(Object, imageHandle, args.This());
+	NanAssignPersistent(Object, bufferHandle, args[0]->ToObject());
+
+	auto buffer = reinterpret_cast<pixel_t*>(Buffer::Data(args[0]->ToObject()));
+	auto length = Buffer::Length(args[0]->ToObject());
+
+	inFormat = SourceFormat(buffer, length);
+	inMat    = cv::Mat(length, 1, CV_8UC1, buffer);
+	animated = false;
+})
+
+OPERATION_CLEANUP(Load, {
+	if (!imageHandle.IsEmpty()) NanDisposePersistent(imageHandle);
+	if (!bufferHandle.IsEmpty()) NanDisposePersistent(bufferHandle);
+})
+
+OPERATION_PROCESS(Load, {
+	DecodePixels(inFormat, inMat, outMat, animated, error);
+
+	// same as decode
+	if (Aborted()) outMat.release();
+})
+
+OPERATION_VALUE(Load, {
+	image->Matrix(outMat);
+	image->Sync(imageHandle);
+
+	// same hint as for decoded images
+	V8::AdjustAmountOfExternalAllocatedMemory(outMat.total());
+
+	return NanPersistentToLocal(imageHandle);
+})
+
+OPERATION_COST(Load, {
+	return EstimateCost(inFormat, inMat);
+})
+
+/**
+ * Decodes an image, setting the error on failure.
+ */
+bool DecodePixels(const string& format, const cv::Mat& inMat, cv::Mat& outMat, bool& animated, string& error) {
+	// OCV only gives the first frame of a gif, and takes the whole file for it.
+	// ours stops right after the first frame and tells whether more follow.
+	if ("gif" == format) {
+		string reason;
+
+		if (!Gif::DecodeFirst(inMat.ptr<pixel_t>(), inMat.total(), outMat, animated, reason)) {
+			error = "operation error: decode: " + reason;
+			return false;
+		}
+
+		return true;
+	}
+
 	try {
 		// decode
 		outMat = cv::Mat(cv::imdecode(inMat, CV_LOAD_IMAGE_UNCHANGED));
@@ -45,14 +128,58 @@ OPERATION_PROCESS(Decode, {
 	// empty matrix, set error
 	if (outMat.empty()) {
 		error = "operation error: decode";
+		return false;
 	}
-})
 
-OPERATION_VALUE(Decode, {
-	return Image::New(outMat, inFormat);
-})
+	return true;
+}
+
+/**
+ * Estimates the amount of work of decoding an image.
+ */
+size_t EstimateCost(const string& format, const cv::Mat& inMat) {
+	auto data   = inMat.ptr<pixel_t>();
+	auto length = inMat.total();
+	uint32_t width, height;
+
+	// known dimensions, the decoded image size is a good estimation
+	if (SourceDimensions(format, data, length, width, height))
+		return Operation::Bytes(width, height, 3);
+
+	// otherwise assume a modest compression ratio
+	return length * 4;
+}
+
+/**
+ * Walks JPEG markers up to the start of frame, returns its offset or 0 if not found.
+ */
+static size_t JpegFrame(pixel_t* data, size_t length) {
+	size_t i = 2;
+
+	while (i + 9 < length) {
+		if (0xff != data[i]) return 0;
+
+		int marker = data[i + 1];
+
+		// padding
+		if (0xff == marker) {
+			i++;
+			continue;
+		}
+
+		// SOF0-SOF15, except DHT, JPG and DAC
+		if (marker >= 0xc0 && marker <= 0xcf && 0xc4 != marker && 0xc8 != marker && 0xcc != marker)
+			return i;
+
+		i += 2 + (data[i + 2] << 8 | data[i + 3]);
+	}
+
+	return 0;
+}
+
+string ribs::SourceFormat(pixel_t* data, size_t length) {
+	if (length < 4) return "";
 
-string Format(pixel_t* data) {
 	// jpeg
 	if (0xff == data[0] && 0xd8 == data[1])
 		return "jpg";
@@ -81,4 +208,55 @@ string Format(pixel_t* data) {
 			return "bmp";
 
 	return "";
-}
\ No newline at end of file
+}
+
+bool ribs::SourceDimensions(const string& format, pixel_t* data, size_t length, uint32_t& width, uint32_t& height) {
+	// png, IHDR is always the first chunk
+	if ("png" == format && length >= 24) {
+		width  = data[16] << 24 | data[17] << 16 | data[18] << 8 | data[19];
+		height = data[20] << 24 | data[21] << 16 | data[22] << 8 | data[23];
+		return true;
+	}
+
+	// gif, logical screen descriptor
+	if ("gif" == format && length >= 10) {
+		width  = data[6] | data[7] << 8;
+		height = data[8] | data[9] << 8;
+		return true;
+	}
+
+	// bmp, height is negative for top-down bitmaps
+	if ("bmp" == format && length >= 26) {
+		width  = data[18] | data[19] << 8 | data[20] << 16 | data[21] << 24;
+		height = abs((int32_t)(data[22] | data[23] << 8 | data[24] << 16 | data[25] << 24));
+		return true;
+	}
+
+	// jpeg, start of frame
+	if ("jpg" == format) {
+		size_t i = JpegFrame(data, length);
+		if (0 == i) return false;
+
+		height = data[i + 5] << 8 | data[i + 6];
+		width  = data[i + 7] << 8 | data[i + 8];
+		return true;
+	}
+
+	return false;
+}
+
+bool ribs::JpegBlockSize(pixel_t* data, size_t length, uint32_t& width, uint32_t& height) {
+	size_t i = JpegFrame(data, length);
+	if (0 == i) return false;
+
+	// largest sampling factors of all components
+	int components = data[i + 9], h = 1, v = 1;
+	for (int c = 0; c < components && i + 11 + c * 3 < length; c++) {
+		h = max(h, data[i + 11 + c * 3] >> 4);
+		v = max(v, data[i + 11 + c * 3] & 0x0f);
+	}
+
+	width  = h * 8;
+	height = v * 8;
+	return true;
+}
@@ -15,8 +15,37 @@ OPERATION(Decode,
 	cv::Mat     inMat;
 	std::string inFormat;
 	cv::Mat     outMat;
+	bool        animated;
 );
 
+/**
+ * Decodes pixels of an image probed from its header, in place.
+ */
+OPERATION(Load,
+	v8::Persistent<v8::Object> imageHandle;
+	v8::Persistent<v8::Object> bufferHandle;
+	Image*      image;
+	cv::Mat     inMat;
+	std::string inFormat;
+	cv::Mat     outMat;
+	bool        animated;
+);
+
+/**
+ * Guesses the format of an encoded image from its first bytes.
+ */
+std::string SourceFormat(pixel_t* data, size_t length);
+
+/**
+ * Reads image dimensions from its header, without decoding it.
+ */
+bool SourceDimensions(const std::string& format, pixel_t* data, size_t length, uint32_t& width, uint32_t& height);
+
+/**
+ * Reads the MCU size of a JPEG image from its start of frame, the granularity at which it can be cropped losslessly.
+ */
+bool JpegBlockSize(pixel_t* data, size_t length, uint32_t& width, uint32_t& height);
+
 }
 
 #endif
\ No newline at end of file
@@ -5,13 +5,22 @@
  */
 
 #include "encode.h"
+#include "../gif.h"
 #include "../image.h"
+#include "../jpeg.h"
+#include "../palette.h"
+#include "../png.h"
 
 using namespace std;
 using namespace v8;
 using namespace node;
 using namespace ribs;
 
+/**
+ * zlib default compression level, used when no quality is given.
+ */
+#define Z_DEFAULT_COMPRESSION_LEVEL 6
+
 OPERATION_PREPARE(Encode, {
 	image = ObjectWrap::Unwrap<Image>(args.This());
 
@@ -20,11 +29,123 @@ OPERATION_PREPARE(Encode, {
 
 	format  = FromV8String(args[0]);
 	quality = args[1]->Uint32Value();
+
+	// byte budget
+	maxBytes   = 0;
+	minQuality = 5;
+	maxTrials  = 8;
+	trials     = 0;
+
+	// png writer, filter defaults depending on the color type
+	filter  = -1;
+	threads = 0;
+	opencv  = false;
+	colors  = 0;
+	dither  = false;
+
+	if (args.Length() > 3 && args[2]->IsObject()) {
+		Local<Object> options = args[2].As<Object>();
+		Local<Value>  value;
+
+		if ((value = options->Get(NanSymbol("maxBytes")))->IsNumber()) {
+			double bytes = value->NumberValue();
+			if (!(bytes >= 0 && bytes <= 4294967295.0) || bytes != floor(bytes))
+				throw invalid_argument("maxBytes must be an integer between 0 and 4294967295");
+			maxBytes = static_cast<size_t>(bytes);
+		}
+		if ((value = options->Get(NanSymbol("minQuality")))->IsNumber())
+			minQuality = value->Int32Value();
+		if ((value = options->Get(NanSymbol("maxTrials")))->IsNumber())
+			maxTrials = value->Int32Value();
+
+		if (maxBytes > 0 && "jpg" != format) throw invalid_argument("maxBytes only applies to jpg");
+		if (minQuality < 1 || minQuality > 100) throw invalid_argument("minQuality must be between 1 and 100");
+		if (maxTrials < 1 || maxTrials > 100) throw invalid_argument("maxTrials must be between 1 and 100");
+
+		Png::Filter parsed;
+		if ((value = options->Get(NanSymbol("filter")))->IsString()) {
+			if (!Png::ParseFilter(FromV8String(value), parsed))
+				throw invalid_argument("invalid filter: " + FromV8String(value));
+			filter = parsed;
+		}
+		if ((value = options->Get(NanSymbol("threads")))->IsNumber())
+			threads = value->Uint32Value();
+
+		// OpenCV encoder, for comparisons
+		opencv = options->Get(NanSymbol("opencv"))->BooleanValue();
+
+		// palette
+		if ((value = options->Get(NanSymbol("colors")))->IsNumber())
+			colors = value->Uint32Value();
+		dither = options->Get(NanSymbol("dither"))->BooleanValue();
+
+		if (colors > 0 && "png" != format && "gif" != format)
+			throw invalid_argument("colors only applies to png and gif");
+		if (colors > 0 && (colors < 2 || colors > 256)) throw invalid_argument("colors must be between 2 and 256");
+	}
 })
 
 OPERATION_CLEANUP(Encode, {})
 
 OPERATION_PROCESS(Encode, {
+	// search the best quality fitting in the budget
+	if (maxBytes > 0) {
+		int chosen = 0;
+		string reason;
+
+		if (!Jpeg::EncodeBudget(image->Matrix(), maxBytes, minQuality, quality > 0 ? quality : 95, maxTrials,
+		                        outVec, chosen, trials, reason, &cancelled)) {
+			if (Aborted()) return;
+			error = "operation error: encode: " + reason;
+			return;
+		}
+
+		quality = chosen;
+		return;
+	}
+
+	// OCV has no gif encoder
+	if ("gif" == format) {
+		string reason;
+
+		if (!Gif::Encode(image->Matrix(), colors > 0 ? colors : 256, dither, outVec, reason))
+			error = "operation error: encode: " + reason;
+
+		return;
+	}
+
+	// parallel png writer, 8 bits only
+	if ("png" == format && !opencv && CV_8U == image->Matrix().depth()) {
+		string reason;
+
+		// RIBS takes a [0,100] value, zlib takes a [0,9] value.
+		int level = (quality > 0 ? quality * 90 / 1000 : Z_DEFAULT_COMPRESSION_LEVEL);
+
+		// palette image: indices barely predict each other, so rows are not filtered by default
+		if (colors > 0) {
+			vector<uint8_t> indices, palette, alpha;
+			Png::Filter f = (filter < 0 ? Png::FILTER_NONE : static_cast<Png::Filter>(filter));
+
+			if (!Palette::Quantize(image->Matrix(), colors, dither, indices, palette, alpha, reason) ||
+			    !Png::EncodeIndexed(indices, image->Width(), image->Height(), palette, alpha, level, f, threads, outVec,
+			                        reason, &cancelled)) {
+				if (Aborted()) return;
+				error = "operation error: encode: " + reason;
+			}
+
+			return;
+		}
+
+		Png::Filter f = (filter < 0 ? Png::FILTER_ADAPTIVE : static_cast<Png::Filter>(filter));
+
+		if (!Png::Encode(image->Matrix(), level, f, threads, outVec, reason, &cancelled)) {
+			if (Aborted()) return;
+			error = "operation error: encode: " + reason;
+		}
+
+		return;
+	}
+
 	try {
 		vector<int> params;
 
@@ -55,5 +176,18 @@ OPERATION_PROCESS(Encode, {
 })
 
 OPERATION_VALUE(Encode, {
-	return NanNewBufferHandle(reinterpret_cast<char*>(&outVec[0]), outVec.size());
-})
\ No newline at end of file
+	Local<Object> buffer = NanNewBufferHandle(reinterpret_cast<char*>(&outVec[0]), outVec.size());
+
+	// report the search outcome along with data
+	if (maxBytes > 0) {
+		buffer->Set(NanSymbol("quality"), Number::New(quality));
+		buffer->Set(NanSymbol("trials"), Number::New(trials));
+	}
+
+	return buffer;
+})
+
+OPERATION_COST(Encode, {
+	// each trial of a budgeted encoding compresses the whole image again
+	return Operation::Bytes(image->Width(), image->Height(), image->Channels(), maxBytes > 0 ? maxTrials : 1);
+})
@@ -16,6 +16,15 @@ OPERATION(Encode,
 	std::vector<uchar> outVec;
 	std::string        format;
 	uint32_t           quality;
+	size_t             maxBytes;
+	int32_t            minQuality;
+	int32_t            maxTrials;
+	int32_t            trials;
+	int32_t            filter;
+	uint32_t           threads;
+	bool               opencv;
+	uint32_t           colors;
+	bool               dither;
 );
 
 }
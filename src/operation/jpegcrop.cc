@@ -0,0 +1,55 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#include "jpegcrop.h"
+#include "decode.h"
+#include "../jpeg.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+using namespace ribs;
+
+OPERATION_PREPARE(JpegCrop, {
+	// check against mandatory buffer input
+	if (!Buffer::HasInstance(args[0])) throw invalid_argument("invalid input buffer");
+
+	// create a persistent object during the process to avoid v8 to dispose the buffer.
+	NanAssignPersistent(Object, bufferHandle, args[0]->ToObject());
+
+	data   = reinterpret_cast<pixel_t*>(Buffer::Data(args[0]->ToObject()));
+	length = Buffer::Length(args[0]->ToObject());
+
+	// store region
+	width  = args[1]->Uint32Value();
+	height = args[2]->Uint32Value();
+	x      = args[3]->Uint32Value();
+	y      = args[4]->Uint32Value();
+})
+
+OPERATION_CLEANUP(JpegCrop, {
+	if (!bufferHandle.IsEmpty()) NanDisposePersistent(bufferHandle);
+})
+
+OPERATION_PROCESS(JpegCrop, {
+	string reason;
+
+	// copy DCT coefficients of the region, no decoding involved
+	if (!Jpeg::Crop(data, length, width, height, x, y, outVec, reason))
+		error = "operation error: jpeg crop: " + reason;
+})
+
+OPERATION_VALUE(JpegCrop, {
+	return NanNewBufferHandle(reinterpret_cast<char*>(&outVec[0]), outVec.size());
+})
+
+OPERATION_COST(JpegCrop, {
+	uint32_t w, h;
+
+	// coefficients of the whole source are read in memory, 2 bytes each, whatever its compressed size
+	if (!SourceDimensions("jpg", data, length, w, h)) return SIZE_MAX;
+	return Operation::Bytes(w, h, 3, 2);
+})
@@ -0,0 +1,27 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#ifndef __RIBS_OPERATION_JPEGCROP_H__
+#define __RIBS_OPERATION_JPEGCROP_H__
+
+#include "../operation.h"
+
+namespace ribs {
+
+OPERATION(JpegCrop,
+	v8::Persistent<v8::Object> bufferHandle;
+	pixel_t*             data;
+	size_t               length;
+	uint32_t             width;
+	uint32_t             height;
+	uint32_t             x;
+	uint32_t             y;
+	std::vector<uint8_t> outVec;
+);
+
+}
+
+#endif
@@ -0,0 +1,89 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#include "levels.h"
+#include "../image.h"
+
+using namespace std;
+using namespace v8;
+using namespace node;
+using namespace ribs;
+
+OPERATION_PREPARE(Levels, {
+	auto image = ObjectWrap::Unwrap<Image>(args.This());
+
+	// check if image is empty
+	if (image->Matrix().empty()) throw invalid_argument("empty image");
+	if (!args[2]->IsArray()) throw invalid_argument("invalid sizes");
+
+	// copy pixels as they are now, the image may be resized or mapped in place meanwhile
+	inMat = image->Matrix().clone();
+
+	format  = FromV8String(args[0]);
+	quality = args[1]->Uint32Value();
+
+	Local<Array> array = args[2].As<Array>();
+	for (uint32_t i = 0; i < array->Length(); i++) {
+		Local<Object> size = array->Get(i)->ToObject();
+		uint32_t width  = size->Get(NanSymbol("width"))->Uint32Value();
+		uint32_t height = size->Get(NanSymbol("height"))->Uint32Value();
+
+		if (0 == width || 0 == height || width > (uint32_t)inMat.cols || height > (uint32_t)inMat.rows)
+			throw invalid_argument("invalid level size");
+
+		sizes.push_back(cv::Size(width, height));
+	}
+})
+
+OPERATION_CLEANUP(Levels, {})
+
+OPERATION_PROCESS(Levels, {
+	vector<int> params;
+
+	// quality
+	if (quality > 0 && "jpg" == format) {
+		params.push_back(CV_IMWRITE_JPEG_QUALITY);
+		params.push_back(quality);
+	}
+
+	// every level is downscaled from full resolution pixels and encoded once, so losses never add up
+	for (auto& size : sizes) {
+		if (Aborted()) return;
+
+		try {
+			cv::Mat res;
+			vector<uchar> outVec;
+
+			cv::resize(inMat, res, size, 0, 0, cv::INTER_AREA);
+			cv::imencode("." + format, res, outVec, params);
+
+			if (outVec.empty()) {
+				error = "operation error: levels";
+				return;
+			}
+
+			outVecs.push_back(outVec);
+		}
+		catch (const cv::Exception& e) {
+			error = "operation error: levels";
+			return;
+		}
+	}
+})
+
+OPERATION_VALUE(Levels, {
+	Local<Array> array = Array::New(outVecs.size());
+
+	for (size_t i = 0; i < outVecs.size(); i++)
+		array->Set(i, NanNewBufferHandle(reinterpret_cast<char*>(&outVecs[i][0]), outVecs[i].size()));
+
+	return array;
+})
+
+OPERATION_COST(Levels, {
+	// each level reads the whole source
+	return Bytes(inMat.cols, inMat.rows, inMat.channels(), sizes.size());
+})
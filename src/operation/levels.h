@@ -0,0 +1,24 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#ifndef __RIBS_OPERATION_LEVELS_H__
+#define __RIBS_OPERATION_LEVELS_H__
+
+#include "../operation.h"
+
+namespace ribs {
+
+OPERATION(Levels,
+	cv::Mat                           inMat;
+	std::string                       format;
+	uint32_t                          quality;
+	std::vector<cv::Size>             sizes;
+	std::vector<std::vector<uchar> >  outVecs;
+);
+
+}
+
+#endif
@@ -7,10 +7,21 @@
 #include "resize.h"
 #include "../image.h"
 
+#include <functional>
+
 using namespace v8;
 using namespace node;
 using namespace ribs;
 
+/**
+ * Number of rows resized at once before being sharpened, and sharpened between two cancellation checks.
+ */
+#define SHARPEN_BAND 64
+
+static void ResizeRows(const cv::Mat& src, cv::Mat& dst, int y0, int y1, cv::Mat& mapX, cv::Mat& mapY);
+static bool Sharpen(cv::Mat& mat, const std::function<void(int, int)>& produce, double amount, double radius,
+                    uint32_t threshold, const std::atomic<bool>& cancelled);
+
 OPERATION_PREPARE(Resize, {
 	// check against mandatory image input (from this)
 	image = ObjectWrap::Unwrap<Image>(args.This());
@@ -21,6 +32,16 @@ OPERATION_PREPARE(Resize, {
 	// store width & height
 	width  = args[0]->Uint32Value();
 	height = args[1]->Uint32Value();
+
+	// optional sharpen / blur kernel, the last argument being always the callback
+	amount    = 0;
+	radius    = 1;
+	threshold = 0;
+	if (args.Length() > 3) {
+		amount    = args[2]->NumberValue();
+		radius    = args[3]->NumberValue();
+		threshold = args[4]->Uint32Value();
+	}
 })
 
 OPERATION_CLEANUP(Resize, {
@@ -29,10 +50,26 @@ OPERATION_CLEANUP(Resize, {
 
 OPERATION_PROCESS(Resize, {
 	try {
+		const cv::Mat& src = image->Matrix();
 		cv::Mat res;
 
-		// resize
-		cv::resize(image->Matrix(), res, cv::Size(width, height), 0, 0);
+		// plain resize, in one go
+		if (0 == amount || radius <= 0 || CV_8U != src.depth() || 0 == width || 0 == height) {
+			cv::resize(src, res, cv::Size(width, height), 0, 0);
+			if (Aborted()) return;
+		}
+		// sharpened resize, output rows are produced band by band and sharpened while they are still in cache
+		else {
+			cv::Mat mapX, mapY;
+
+			res.create(height, width, src.type());
+			auto produce = [&](int y0, int y1) { ResizeRows(src, res, y0, y1, mapX, mapY); };
+
+			if (!Sharpen(res, produce, amount, radius, threshold, cancelled)) {
+				Aborted();
+				return;
+			}
+		}
 
 		image->Matrix(res);
 	}
@@ -45,3 +82,130 @@ OPERATION_VALUE(Resize, {
 	image->Sync(imageHandle);
 	return NanPersistentToLocal(imageHandle);
 })
+
+OPERATION_COST(Resize, {
+	// sharpening is a few times more expensive than resizing
+	return std::max<size_t>(Bytes(image->Width(), image->Height(), image->Channels(), 0 != amount ? 4 : 1),
+	                        Bytes(width, height, image->Channels(), 0 != amount ? 4 : 1));
+})
+
+/**
+ * Resizes `src` into rows `[y0, y1)` of `dst` only, bilinearly, sampling the same source positions as `cv::resize`.
+ * Sampling maps are reused from one band to the next.
+ */
+void ResizeRows(const cv::Mat& src, cv::Mat& dst, int y0, int y1, cv::Mat& mapX, cv::Mat& mapY) {
+	double scaleX = double(src.cols) / dst.cols;
+	double scaleY = double(src.rows) / dst.rows;
+
+	mapX.create(y1 - y0, dst.cols, CV_32F);
+	mapY.create(y1 - y0, dst.cols, CV_32F);
+
+	for (int y = y0; y < y1; y++) {
+		float* xs = mapX.ptr<float>(y - y0);
+		float* ys = mapY.ptr<float>(y - y0);
+		float  sy = static_cast<float>((y + 0.5) * scaleY - 0.5);
+
+		for (int x = 0; x < dst.cols; x++) {
+			xs[x] = static_cast<float>((x + 0.5) * scaleX - 0.5);
+			ys[x] = sy;
+		}
+	}
+
+	// band is a view of `dst`, remap writes in place
+	cv::Mat band = dst.rowRange(y0, y1);
+	cv::remap(src, band, mapX, mapY, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+}
+
+/**
+ * Applies an unsharp mask in place.
+ *
+ * A positive `amount` sharpens, a negative one blurs (`-1` being a plain gaussian blur). Differences with the blurred
+ * image smaller than `threshold` are left untouched, which avoids to amplify noise in flat areas.
+ *
+ * Instead of blurring the whole image in a second matrix, rows are swept from top to bottom. Horizontally blurred rows
+ * are kept in a ring buffer of `2 * half + 1` rows, so each row is blurred vertically and written back while its
+ * neighbours are still in cache. As a row is written back only once every row depending on its original value has
+ * been pushed to the ring, the sharpening can safely happen in place.
+ *
+ * Rows are not expected to be there beforehand: `produce(y0, y1)` is asked for bands of `SHARPEN_BAND` rows just
+ * before the first of them enters the ring, so a band is sharpened right after being produced.
+ *
+ * Returns `false` if cancelled in the middle, `cancelled` being checked between bands of rows.
+ */
+bool Sharpen(cv::Mat& mat, const std::function<void(int, int)>& produce, double amount, double radius,
+             uint32_t threshold, const std::atomic<bool>& cancelled) {
+	int rows     = mat.rows;
+	int cols     = mat.cols;
+	int channels = mat.channels();
+	int colors   = std::min(channels, 3);
+	int half     = std::max(1, cvCeil(radius * 2));
+	int size     = 2 * half + 1;
+	int stride   = cols * channels;
+	int produced = 0;
+
+	if (CV_8U != mat.depth() || 0 == rows || 0 == cols) return true;
+
+	cv::Mat kernelMat = cv::getGaussianKernel(size, radius, CV_32F);
+	const float* kernel = kernelMat.ptr<float>();
+
+	// ring buffer of horizontally blurred rows
+	cv::Mat ring(size, stride, CV_32F);
+	// vertically blurred row
+	std::vector<float> blurred(stride);
+
+	auto blurRow = [&](int y) {
+		if (y >= produced) {
+			produce(produced, std::min(produced + SHARPEN_BAND, rows));
+			produced = std::min(produced + SHARPEN_BAND, rows);
+		}
+
+		const pixel_t* src = mat.ptr<pixel_t>(y);
+		float* dst = ring.ptr<float>(y % size);
+
+		for (int x = 0; x < cols; x++) {
+			for (int c = 0; c < colors; c++) {
+				float sum = 0;
+				for (int k = -half; k <= half; k++) {
+					int sx = std::min(std::max(x + k, 0), cols - 1);
+					sum += kernel[k + half] * src[sx * channels + c];
+				}
+				dst[x * channels + c] = sum;
+			}
+		}
+	};
+
+	// prime the ring with the rows below the first one
+	for (int y = 0; y <= half && y < rows; y++)
+		blurRow(y);
+
+	for (int y = 0; y < rows; y++) {
+		if (0 == y % SHARPEN_BAND && cancelled) return false;
+
+		// vertical pass, rows outside of the image are replicated from the edges
+		std::fill(blurred.begin(), blurred.end(), 0.f);
+		for (int k = -half; k <= half; k++) {
+			int sy = std::min(std::max(y + k, 0), rows - 1);
+			const float* src = ring.ptr<float>(sy % size);
+			float weight = kernel[k + half];
+			for (int i = 0; i < stride; i++)
+				blurred[i] += weight * src[i];
+		}
+
+		// row y + half has not been written back yet, blur it before it leaves the window
+		if (y + half + 1 < rows)
+			blurRow(y + half + 1);
+
+		// write back the sharpened row
+		pixel_t* row = mat.ptr<pixel_t>(y);
+		for (int x = 0; x < cols; x++) {
+			for (int c = 0; c < colors; c++) {
+				int i = x * channels + c;
+				float diff = row[i] - blurred[i];
+				if (std::abs(diff) < threshold) continue;
+				row[i] = cv::saturate_cast<pixel_t>(row[i] + amount * diff);
+			}
+		}
+	}
+
+	return true;
+}
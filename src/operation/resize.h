@@ -16,8 +16,11 @@ OPERATION(Resize,
 	v8::Persistent<v8::Object> imageHandle;
 	uint32_t width;
 	uint32_t height;
+	double   amount;
+	double   radius;
+	uint32_t threshold;
 );
 
 }
 
-#endif
\ No newline at end of file
+#endif
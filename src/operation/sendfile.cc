@@ -0,0 +1,121 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#include "sendfile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#ifdef __APPLE__
+#include <sys/uio.h>
+#else
+#include <sys/sendfile.h>
+#endif
+
+using namespace std;
+using namespace v8;
+using namespace node;
+using namespace ribs;
+
+/**
+ * Maximum number of bytes handed to a single `sendfile` call.
+ */
+#define SENDFILE_CHUNK (1 << 20)
+
+// node ignores SIGPIPE anyway
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/**
+ * Copies up to `count` bytes of a file, from `offset`, to a socket. Returns the number of bytes copied or -1.
+ */
+static ssize_t Transfer(int out, int in, off_t offset, size_t count) {
+#ifdef __APPLE__
+	off_t length = count;
+
+	// partial writes of non-blocking sockets fail with EAGAIN but still tell what was written
+	if (0 != sendfile(in, out, offset, &length, NULL, 0) && (EAGAIN != errno || 0 == length)) return -1;
+	return length;
+#else
+	return sendfile(out, in, &offset, count);
+#endif
+}
+
+OPERATION_PREPARE(Sendfile, {
+	if (!args[0]->IsNumber() || args[0]->Int32Value() < 0) throw invalid_argument("invalid socket");
+	if (!args[1]->IsNumber() || args[1]->Int32Value() < 0) throw invalid_argument("invalid file");
+	if (!Buffer::HasInstance(args[4])) throw invalid_argument("invalid header");
+
+	offset = args[2]->IntegerValue();
+	length = args[3]->IntegerValue();
+	if (offset < 0) throw invalid_argument("invalid offset");
+
+	// the socket is owned by node, that may close it meanwhile: a duplicate keeps its number from being reused
+	out = dup(args[0]->Int32Value());
+	if (out < 0) throw invalid_argument("invalid socket");
+
+	in   = args[1]->Int32Value();
+	sent = 0;
+
+	// create a persistent object during the process to avoid v8 to dispose the buffer.
+	NanAssignPersistent(Object, headerHandle, args[4]->ToObject());
+
+	header       = Buffer::Data(args[4]->ToObject());
+	headerLength = Buffer::Length(args[4]->ToObject());
+})
+
+OPERATION_CLEANUP(Sendfile, {
+	if (!headerHandle.IsEmpty()) NanDisposePersistent(headerHandle);
+	close(out);
+})
+
+OPERATION_PROCESS(Sendfile, {
+	// the socket is non-blocking: once its buffer is full, what is left is written by the event loop.
+	// this way a slow client never holds a thread of the pool.
+	while (sent < headerLength + length) {
+		ssize_t count;
+
+		if (sent < headerLength) {
+			count = send(out, header + sent, headerLength - sent, MSG_NOSIGNAL);
+		}
+		else {
+			size_t done = sent - headerLength;
+			count = Transfer(out, in, offset + done, min<size_t>(length - done, SENDFILE_CHUNK));
+		}
+
+		if (count < 0 && EINTR == errno) continue;
+		if (count < 0 && (EAGAIN == errno || EWOULDBLOCK == errno)) return;
+
+		if (count < 0) {
+			error = string("operation error: sendfile: ") + strerror(errno);
+			return;
+		}
+
+		// the file is shorter than expected
+		if (0 == count) {
+			error = "operation error: sendfile: truncated file";
+			return;
+		}
+
+		sent += count;
+	}
+})
+
+OPERATION_VALUE(Sendfile, {
+	return Number::New(sent);
+})
+
+OPERATION_COST(Sendfile, {
+	// reading the file may hit the disk, never block the event loop with it
+	return SIZE_MAX;
+})
+
+NAN_METHOD(ribs::Sendfile) {
+	RIBS_OPERATION(Sendfile);
+}
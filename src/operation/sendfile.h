@@ -0,0 +1,32 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#ifndef __RIBS_OPERATION_SENDFILE_H__
+#define __RIBS_OPERATION_SENDFILE_H__
+
+#include "../operation.h"
+
+namespace ribs {
+
+OPERATION(Sendfile,
+	v8::Persistent<v8::Object> headerHandle;
+	int         out;
+	int         in;
+	off_t       offset;
+	size_t      length;
+	const char* header;
+	size_t      headerLength;
+	size_t      sent;
+);
+
+/**
+ * Writes a header then a region of a file to a socket, without copying the file data to user space.
+ */
+NAN_METHOD(Sendfile);
+
+}
+
+#endif
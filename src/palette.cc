@@ -0,0 +1,361 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#include "palette.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+using namespace std;
+using namespace ribs;
+
+/**
+ * Maximum number of pixels sampled to build the histogram.
+ */
+#define MAX_SAMPLES (1 << 18)
+
+/**
+ * Number of k-means iterations refining the median cut palette.
+ */
+#define KMEANS_ITERATIONS 3
+
+/**
+ * A color, as red, green, blue and alpha components.
+ */
+typedef int Color[4];
+
+/**
+ * Histogram bin: number of samples and sum of their components, to compute their mean color.
+ */
+struct Bin {
+	uint32_t count;
+	uint64_t sum[4];
+	int      mean[4];
+};
+
+/**
+ * Box of the median cut, a set of bins.
+ */
+struct Box {
+	vector<uint32_t> bins;
+	uint64_t         count;
+	int              axis;
+	int              range;
+};
+
+/**
+ * Bins layout: 5 bits per color component for opaque images, 4 bits per component for translucent ones.
+ */
+struct Layout {
+	bool translucent;
+
+	size_t Size() const {
+		return translucent ? (1 << 16) : (1 << 15);
+	}
+
+	uint32_t Of(const Color& c) const {
+		if (translucent)
+			return ((c[0] >> 4) << 12) | ((c[1] >> 4) << 8) | ((c[2] >> 4) << 4) | (c[3] >> 4);
+		return ((c[0] >> 3) << 10) | ((c[1] >> 3) << 5) | (c[2] >> 3);
+	}
+
+	void Center(uint32_t bin, Color& c) const {
+		if (translucent) {
+			c[0] = ((bin >> 12) & 15) * 17;
+			c[1] = ((bin >> 8) & 15) * 17;
+			c[2] = ((bin >> 4) & 15) * 17;
+			c[3] = (bin & 15) * 17;
+		}
+		else {
+			c[0] = (((bin >> 10) & 31) << 3) | 4;
+			c[1] = (((bin >> 5) & 31) << 3) | 4;
+			c[2] = ((bin & 31) << 3) | 4;
+			c[3] = 255;
+		}
+	}
+};
+
+static inline void ReadPixel(const uint8_t* p, int channels, Color& c) {
+	if (channels < 3) {
+		c[0] = c[1] = c[2] = p[0];
+		c[3] = (2 == channels ? p[1] : 255);
+	}
+	else {
+		c[0] = p[2];
+		c[1] = p[1];
+		c[2] = p[0];
+		c[3] = (4 == channels ? p[3] : 255);
+	}
+}
+
+static inline int Distance(const Color& a, const int* b) {
+	int d0 = a[0] - b[0], d1 = a[1] - b[1], d2 = a[2] - b[2], d3 = a[3] - b[3];
+	return d0 * d0 + d1 * d1 + d2 * d2 + d3 * d3;
+}
+
+static int Nearest(const Color& c, const vector<int>& entries) {
+	int best = 0, bestDistance = INT_MAX;
+
+	for (size_t i = 0, count = entries.size() / 4; i < count; i++) {
+		int d = Distance(c, &entries[i * 4]);
+		if (d < bestDistance) {
+			bestDistance = d;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+static void Measure(Box& box, const vector<Bin>& bins) {
+	int lo[4] = { 255, 255, 255, 255 }, hi[4] = { 0, 0, 0, 0 };
+
+	box.count = 0;
+	for (auto it = box.bins.begin(); it != box.bins.end(); it++) {
+		const Bin& bin = bins[*it];
+		box.count += bin.count;
+		for (int c = 0; c < 4; c++) {
+			lo[c] = min(lo[c], bin.mean[c]);
+			hi[c] = max(hi[c], bin.mean[c]);
+		}
+	}
+
+	box.axis = 0;
+	box.range = 0;
+	for (int c = 0; c < 4; c++) {
+		if (hi[c] - lo[c] > box.range) {
+			box.range = hi[c] - lo[c];
+			box.axis = c;
+		}
+	}
+}
+
+/**
+ * Maps pixels to their nearest palette entry, through a lookup table indexed by bins and filled on first use.
+ */
+static void MapPixels(const cv::Mat& mat, const Layout& layout, const vector<int>& entries, vector<int16_t>& lut,
+                      bool dither, uint8_t* indices) {
+	int    channels = mat.channels();
+	size_t width = mat.cols, height = mat.rows;
+	Color  color;
+
+	auto lookup = [&](const Color& c) -> int {
+		uint32_t bin = layout.Of(c);
+
+		if (lut[bin] < 0) {
+			Color center;
+			layout.Center(bin, center);
+			lut[bin] = Nearest(center, entries);
+		}
+
+		return lut[bin];
+	};
+
+	if (!dither) {
+		for (size_t y = 0; y < height; y++) {
+			const uint8_t* row = mat.ptr(y);
+			uint8_t* out = indices + y * width;
+
+			for (size_t x = 0; x < width; x++) {
+				ReadPixel(row + x * channels, channels, color);
+				out[x] = lookup(color);
+			}
+		}
+	}
+	else {
+		// Floyd-Steinberg, serpentine scan, errors in 1/16th.
+		// alpha is not dithered, noise in transparency looks worse than banding.
+		vector<int> errors((width + 2) * 3 * 2, 0);
+		int* current = &errors[0];
+		int* next = &errors[(width + 2) * 3];
+
+		for (size_t y = 0; y < height; y++) {
+			const uint8_t* row = mat.ptr(y);
+			uint8_t* out = indices + y * width;
+			bool reverse = (y & 1);
+			int dir = (reverse ? -1 : 1);
+
+			memset(next, 0, (width + 2) * 3 * sizeof(int));
+
+			for (size_t i = 0; i < width; i++) {
+				size_t x = (reverse ? width - 1 - i : i);
+				int* e = &current[(x + 1) * 3];
+				int* n = &next[(x + 1) * 3];
+
+				ReadPixel(row + x * channels, channels, color);
+				for (int c = 0; c < 3; c++)
+					color[c] = min(255, max(0, color[c] + (e[c] + 8) / 16));
+
+				int index = lookup(color);
+				out[x] = index;
+
+				for (int c = 0; c < 3; c++) {
+					int diff = color[c] - entries[index * 4 + c];
+					e[dir * 3 + c] += diff * 7;
+					n[-dir * 3 + c] += diff * 3;
+					n[c] += diff * 5;
+					n[dir * 3 + c] += diff;
+				}
+			}
+
+			swap(current, next);
+		}
+	}
+}
+
+bool Palette::Quantize(const cv::Mat& mat, uint32_t colors, bool dither, vector<uint8_t>& indices,
+                       vector<uint8_t>& palette, vector<uint8_t>& alpha, string& error) {
+	int channels = mat.channels();
+
+	if (CV_8U != mat.depth() || channels < 1 || channels > 4 || mat.empty()) {
+		error = "unsupported image type";
+		return false;
+	}
+
+	if (colors < 2 || colors > 256) {
+		error = "invalid number of colors";
+		return false;
+	}
+
+	size_t width = mat.cols, height = mat.rows, total = width * height;
+	Layout layout = { 2 == channels || 4 == channels };
+	Color  color;
+
+	// histogram of a subsample of pixels
+	vector<Bin> bins(layout.Size());
+	memset(&bins[0], 0, bins.size() * sizeof(Bin));
+
+	size_t step = max<size_t>(1, total / MAX_SAMPLES);
+	for (size_t i = 0; i < total; i += step) {
+		ReadPixel(mat.ptr(i / width) + (i % width) * channels, channels, color);
+
+		Bin& bin = bins[layout.Of(color)];
+		bin.count++;
+		for (int c = 0; c < 4; c++) bin.sum[c] += color[c];
+	}
+
+	Box all;
+	for (uint32_t i = 0; i < bins.size(); i++) {
+		Bin& bin = bins[i];
+		if (0 == bin.count) continue;
+
+		for (int c = 0; c < 4; c++) bin.mean[c] = bin.sum[c] / bin.count;
+		all.bins.push_back(i);
+	}
+
+	// median cut: split the box with the widest spread of samples until there are enough boxes
+	vector<Box> boxes(1, all);
+	Measure(boxes[0], bins);
+
+	while (boxes.size() < colors) {
+		int target = -1;
+		uint64_t score = 0;
+
+		for (size_t i = 0; i < boxes.size(); i++) {
+			uint64_t s = boxes[i].count * boxes[i].range;
+			if (boxes[i].bins.size() > 1 && s > score) {
+				score = s;
+				target = i;
+			}
+		}
+
+		// nothing left to split
+		if (target < 0) break;
+
+		Box& box = boxes[target];
+		int axis = box.axis;
+
+		sort(box.bins.begin(), box.bins.end(), [&](uint32_t a, uint32_t b) {
+			return bins[a].mean[axis] < bins[b].mean[axis];
+		});
+
+		// split at the median sample
+		uint64_t half = box.count / 2, count = 0;
+		size_t at = 0;
+		while (at < box.bins.size() - 1 && count + bins[box.bins[at]].count <= half)
+			count += bins[box.bins[at++]].count;
+		at = max<size_t>(at, 1);
+
+		Box other;
+		other.bins.assign(box.bins.begin() + at, box.bins.end());
+		box.bins.resize(at);
+
+		Measure(box, bins);
+		Measure(other, bins);
+		boxes.push_back(other);
+	}
+
+	// palette entries are the mean of their box
+	vector<int> entries(boxes.size() * 4);
+	for (size_t i = 0; i < boxes.size(); i++) {
+		uint64_t sum[4] = { 0, 0, 0, 0 }, count = 0;
+
+		for (auto it = boxes[i].bins.begin(); it != boxes[i].bins.end(); it++) {
+			count += bins[*it].count;
+			for (int c = 0; c < 4; c++) sum[c] += bins[*it].sum[c];
+		}
+
+		for (int c = 0; c < 4; c++) entries[i * 4 + c] = (count ? sum[c] / count : 0);
+	}
+
+	// k-means refinement over bins, weighted by their number of samples
+	for (int iteration = 0; iteration < KMEANS_ITERATIONS; iteration++) {
+		vector<uint64_t> sums(entries.size(), 0), counts(boxes.size(), 0);
+
+		for (auto it = all.bins.begin(); it != all.bins.end(); it++) {
+			const Bin& bin = bins[*it];
+			int nearest = Nearest(bin.mean, entries);
+
+			counts[nearest] += bin.count;
+			for (int c = 0; c < 4; c++) sums[nearest * 4 + c] += bin.sum[c];
+		}
+
+		for (size_t i = 0; i < boxes.size(); i++) {
+			if (0 == counts[i]) continue;
+			for (int c = 0; c < 4; c++) entries[i * 4 + c] = sums[i * 4 + c] / counts[i];
+		}
+	}
+
+	// nearest entry of each bin, computed on first use
+	vector<int16_t> lut(layout.Size(), -1);
+
+	indices.resize(total);
+	MapPixels(mat, layout, entries, lut, dither, &indices[0]);
+
+	// output palette
+	bool transparent = false;
+
+	palette.resize(boxes.size() * 3);
+	alpha.resize(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++) {
+		for (int c = 0; c < 3; c++) palette[i * 3 + c] = entries[i * 4 + c];
+		alpha[i] = entries[i * 4 + 3];
+		transparent = transparent || alpha[i] < 255;
+	}
+
+	if (!transparent) alpha.clear();
+
+	return true;
+}
+
+Palette::Palette(const vector<uint8_t>& palette) {
+	Layout layout = { false };
+
+	for (size_t i = 0; i + 2 < palette.size(); i += 3) {
+		entries.push_back(palette[i]);
+		entries.push_back(palette[i + 1]);
+		entries.push_back(palette[i + 2]);
+		entries.push_back(255);
+	}
+
+	lut.assign(layout.Size(), -1);
+}
+
+void Palette::Map(const cv::Mat& mat, bool dither, uint8_t* indices) {
+	Layout layout = { false };
+	MapPixels(mat, layout, entries, lut, dither, indices);
+}
@@ -0,0 +1,52 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#ifndef __RIBS_PALETTE_H__
+#define __RIBS_PALETTE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <cv.h>
+
+namespace ribs {
+
+/**
+ * Color quantization, to produce palette images.
+ */
+class Palette {
+public:
+	/**
+	 * Reduces an 8 bits image, with 1 to 4 channels, to at most `colors` colors.
+	 *
+	 * The palette is built by a median cut over a histogram of a subsample of pixels, refined by a few k-means
+	 * iterations. Pixels are then mapped through a lookup table indexed by histogram bins, optionally with Floyd-Steinberg
+	 * dithering.
+	 *
+	 * `indices` gets one palette index per pixel, `palette` RGB triplets and `alpha` the alpha value of each palette
+	 * entry, or nothing if the image is opaque.
+	 */
+	static bool Quantize(const cv::Mat& mat, uint32_t colors, bool dither, std::vector<uint8_t>& indices,
+	                     std::vector<uint8_t>& palette, std::vector<uint8_t>& alpha, std::string& error);
+
+	/**
+	 * Prepares mapping of images to a fixed palette of RGB triplets, the lookup table being shared by all of them.
+	 */
+	explicit Palette(const std::vector<uint8_t>& palette);
+
+	/**
+	 * Maps an 8 bits image, with 1 to 4 channels, to palette indices, alpha being ignored.
+	 */
+	void Map(const cv::Mat& mat, bool dither, uint8_t* indices);
+
+private:
+	std::vector<int>     entries;
+	std::vector<int16_t> lut;
+};
+
+}
+
+#endif
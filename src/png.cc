@@ -0,0 +1,405 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#include "png.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#include <zlib.h>
+
+using namespace std;
+using namespace ribs;
+
+/**
+ * Bytes of filtered data compressed by each job.
+ * Smaller chunks spread better over cores, but each one costs a flush and a dictionary priming.
+ */
+#define CHUNK_SIZE (256 * 1024)
+
+/**
+ * Deflate window, that is the size of dictionaries.
+ */
+#define WINDOW_SIZE 32768
+
+/**
+ * Number of images being written, each one from its own libuv worker (at most `UV_THREADPOOL_SIZE`).
+ */
+static atomic<uint32_t> writers(0);
+
+/**
+ * Runs `count` jobs over at most `threads` threads, the calling one included.
+ * Remaining jobs are skipped once `cancelled` gets set.
+ * If threads can't be created, jobs are run by the ones already there, down to the calling one alone.
+ * An exception escaping a thread terminates the process: the first one thrown by a job skips remaining jobs, and is
+ * rethrown by the calling thread once every thread is done.
+ */
+static void Parallel(size_t count, uint32_t threads, const atomic<bool>* cancelled, const function<void(size_t)>& job) {
+	atomic<size_t> next(0);
+	atomic<bool> failed(false);
+	exception_ptr failure;
+	mutex lock;
+	vector<thread> workers;
+
+	auto worker = [&]() {
+		try {
+			for (size_t i = next++; i < count && !failed && !(cancelled && *cancelled); i = next++)
+				job(i);
+		}
+		catch (...) {
+			lock_guard<mutex> guard(lock);
+			if (!failure) failure = current_exception();
+			failed = true;
+		}
+	};
+
+	threads = min<size_t>(threads, count);
+
+	// a thread must not be dropped once started, allocate slots beforehand
+	workers.reserve(threads);
+	for (uint32_t i = 1; i < threads; i++) {
+		try {
+			workers.push_back(thread(worker));
+		}
+		catch (const system_error& e) {
+			break;
+		}
+	}
+
+	worker();
+
+	for (auto it = workers.begin(); it != workers.end(); it++)
+		it->join();
+
+	if (failure) rethrow_exception(failure);
+}
+
+static inline uint8_t Paeth(int a, int b, int c) {
+	int p  = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+
+	if (pa <= pb && pa <= pc) return a;
+	if (pb <= pc) return b;
+	return c;
+}
+
+/**
+ * Filters a row with a given filter, writing the filter type then the filtered bytes.
+ * Returns the sum of absolute values of filtered bytes taken as signed, the usual heuristic to compare filters.
+ */
+static uint32_t FilterRow(Png::Filter filter, const uint8_t* row, const uint8_t* prev, size_t length, size_t bpp,
+                          uint8_t* out) {
+	uint32_t sum = 0;
+
+	*out++ = filter;
+
+	for (size_t i = 0; i < length; i++) {
+		int a = (i >= bpp ? row[i - bpp] : 0);
+		int b = prev[i];
+		int c = (i >= bpp ? prev[i - bpp] : 0);
+		uint8_t value;
+
+		switch (filter) {
+			case Png::FILTER_SUB:   value = row[i] - a; break;
+			case Png::FILTER_UP:    value = row[i] - b; break;
+			case Png::FILTER_AVG:   value = row[i] - ((a + b) >> 1); break;
+			case Png::FILTER_PAETH: value = row[i] - Paeth(a, b, c); break;
+			default:                value = row[i]; break;
+		}
+
+		out[i] = value;
+		sum += (value < 128 ? value : 256 - value);
+	}
+
+	return sum;
+}
+
+/**
+ * Converts a row from OpenCV channel order to PNG one.
+ */
+static void ConvertRow(const uint8_t* src, size_t width, int channels, uint8_t* dst) {
+	if (channels < 3) {
+		memcpy(dst, src, width * channels);
+		return;
+	}
+
+	for (size_t x = 0; x < width; x++, src += channels, dst += channels) {
+		dst[0] = src[2];
+		dst[1] = src[1];
+		dst[2] = src[0];
+		if (4 == channels) dst[3] = src[3];
+	}
+}
+
+static void WriteUint32(vector<uint8_t>& out, uint32_t value) {
+	out.push_back(value >> 24);
+	out.push_back(value >> 16);
+	out.push_back(value >> 8);
+	out.push_back(value);
+}
+
+static void WriteChunk(vector<uint8_t>& out, const char* type, const uint8_t* data, size_t length) {
+	WriteUint32(out, length);
+
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + length);
+
+	WriteUint32(out, crc32(0, &out[start], length + 4));
+}
+
+/**
+ * Rows of an image to write, in PNG layout.
+ */
+struct Rows {
+	size_t  width;
+	size_t  rows;
+	size_t  bpp;
+	uint8_t colorType;
+	function<void(size_t, uint8_t*)> row;
+};
+
+/**
+ * Filters, compresses and writes rows as a PNG file, with an optional palette.
+ * Throws on allocation failures, use `Write` instead.
+ */
+static bool WriteRows(const Rows& image, const uint8_t* palette, size_t paletteLength, const uint8_t* alpha,
+                      size_t alphaLength, int level, Png::Filter filter, uint32_t threads, vector<uint8_t>& out,
+                      string& error, const atomic<bool>* cancelled) {
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	// cores are shared among images being written concurrently, so that pool threads do not oversubscribe them
+	struct Writer {
+		Writer()  { writers++; }
+		~Writer() { writers--; }
+	} writer;
+
+	uint32_t share = max(1u, max(1u, thread::hardware_concurrency()) / writers);
+	threads = (0 == threads ? share : min(threads, share));
+	level = max(0, min(level, 9));
+
+	size_t rows   = image.rows;
+	size_t width  = image.width;
+	size_t bpp    = image.bpp;
+	size_t stride = width * bpp;
+	size_t line   = stride + 1;
+
+	// filter rows, in bands of rows so that each thread converts each row once
+	vector<uint8_t> filtered(rows * line);
+	size_t bands = min<size_t>(rows, threads * 4);
+
+	Parallel(bands, threads, cancelled, [&](size_t band) {
+		size_t first = rows * band / bands;
+		size_t last  = rows * (band + 1) / bands;
+
+		vector<uint8_t> prev(stride, 0), row(stride), scratch(line), best(line);
+
+		// previous row of the band
+		if (first > 0) image.row(first - 1, &prev[0]);
+
+		for (size_t y = first; y < last; y++) {
+			uint8_t* out = &filtered[y * line];
+
+			image.row(y, &row[0]);
+
+			if (Png::FILTER_ADAPTIVE != filter)
+				FilterRow(filter, &row[0], &prev[0], stride, bpp, out);
+			else {
+				uint32_t bestSum = UINT32_MAX;
+
+				for (int f = Png::FILTER_NONE; f <= Png::FILTER_PAETH; f++) {
+					uint32_t sum = FilterRow(static_cast<Png::Filter>(f), &row[0], &prev[0], stride, bpp, &scratch[0]);
+					if (sum < bestSum) {
+						bestSum = sum;
+						best.swap(scratch);
+					}
+				}
+
+				memcpy(out, &best[0], line);
+			}
+
+			prev.swap(row);
+		}
+	});
+
+	// compress chunks of filtered data as raw deflate streams
+	size_t total  = filtered.size();
+	size_t chunks = (total + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	vector<vector<uint8_t>> compressed(chunks);
+	vector<uLong> checksums(chunks);
+	atomic<bool> failed(false);
+
+	Parallel(chunks, threads, cancelled, [&](size_t i) {
+		size_t start  = i * CHUNK_SIZE;
+		size_t length = min<size_t>(CHUNK_SIZE, total - start);
+		bool   last   = (chunks - 1 == i);
+		z_stream stream;
+
+		memset(&stream, 0, sizeof(stream));
+		if (Z_OK != deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)) {
+			failed = true;
+			return;
+		}
+
+		// prime with the end of the previous chunk, so that matches can span chunks
+		if (start > 0) {
+			size_t window = min<size_t>(WINDOW_SIZE, start);
+			deflateSetDictionary(&stream, &filtered[start - window], window);
+		}
+
+		vector<uint8_t>& dst = compressed[i];
+		dst.resize(deflateBound(&stream, length) + 16);
+
+		stream.next_in   = &filtered[start];
+		stream.avail_in  = length;
+		stream.next_out  = &dst[0];
+		stream.avail_out = dst.size();
+
+		// all but the last chunk end on a byte boundary, without the final block flag
+		int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+		if ((last ? Z_STREAM_END : Z_OK) != status || 0 != stream.avail_in) failed = true;
+
+		dst.resize(stream.total_out);
+		deflateEnd(&stream);
+
+		checksums[i] = adler32(adler32(0, NULL, 0), &filtered[start], length);
+	});
+
+	if (cancelled && *cancelled) {
+		error = "cancelled";
+		return false;
+	}
+
+	if (failed) {
+		error = "deflate failed";
+		return false;
+	}
+
+	// zlib stream: header, chunks, then the checksum of the whole data
+	vector<uint8_t> idat;
+	uint8_t cmf = 0x78;
+	uint8_t flg = (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+	flg += 31 - ((cmf * 256 + flg) % 31);
+
+	uLong adler = adler32(0, NULL, 0);
+	size_t size = 2 + 4;
+	for (size_t i = 0; i < chunks; i++) {
+		size_t length = min<size_t>(CHUNK_SIZE, total - i * CHUNK_SIZE);
+		adler = adler32_combine(adler, checksums[i], length);
+		size += compressed[i].size();
+	}
+
+	idat.reserve(size);
+	idat.push_back(cmf);
+	idat.push_back(flg);
+	for (size_t i = 0; i < chunks; i++) {
+		idat.insert(idat.end(), compressed[i].begin(), compressed[i].end());
+		vector<uint8_t>().swap(compressed[i]);
+	}
+	WriteUint32(idat, adler);
+
+	// png file
+	uint8_t ihdr[13] = {
+		uint8_t(width >> 24), uint8_t(width >> 16), uint8_t(width >> 8), uint8_t(width),
+		uint8_t(rows >> 24), uint8_t(rows >> 16), uint8_t(rows >> 8), uint8_t(rows),
+		8, image.colorType, 0, 0, 0
+	};
+
+	out.clear();
+	out.reserve(idat.size() + 64);
+	out.insert(out.end(), signature, signature + sizeof(signature));
+	WriteChunk(out, "IHDR", ihdr, sizeof(ihdr));
+	if (palette) WriteChunk(out, "PLTE", palette, paletteLength);
+	if (alpha) WriteChunk(out, "tRNS", alpha, alphaLength);
+	WriteChunk(out, "IDAT", &idat[0], idat.size());
+	WriteChunk(out, "IEND", NULL, 0);
+
+	return true;
+}
+
+/**
+ * Same as `WriteRows`, failures of any thread being reported through `error`.
+ */
+static bool Write(const Rows& image, const uint8_t* palette, size_t paletteLength, const uint8_t* alpha,
+                  size_t alphaLength, int level, Png::Filter filter, uint32_t threads, vector<uint8_t>& out,
+                  string& error, const atomic<bool>* cancelled) {
+	try {
+		return WriteRows(image, palette, paletteLength, alpha, alphaLength, level, filter, threads, out, error,
+		                 cancelled);
+	}
+	catch (const bad_alloc&) {
+		error = "out of memory";
+	}
+	catch (const exception& e) {
+		error = e.what();
+	}
+
+	out.clear();
+	return false;
+}
+
+bool Png::Encode(const cv::Mat& mat, int level, Filter filter, uint32_t threads, vector<uint8_t>& out,
+                 string& error, const atomic<bool>* cancelled) {
+	static const uint8_t colorTypes[] = { 0, 0, 4, 2, 6 };
+
+	int channels = mat.channels();
+
+	if (CV_8U != mat.depth() || channels < 1 || channels > 4 || mat.empty()) {
+		error = "unsupported image type";
+		return false;
+	}
+
+	Rows rows = {
+		size_t(mat.cols), size_t(mat.rows), size_t(channels), colorTypes[channels],
+		[&](size_t y, uint8_t* dst) {
+			ConvertRow(mat.ptr(y), mat.cols, channels, dst);
+		}
+	};
+
+	return Write(rows, NULL, 0, NULL, 0, level, filter, threads, out, error, cancelled);
+}
+
+bool Png::EncodeIndexed(const vector<uint8_t>& indices, uint32_t width, uint32_t height, const vector<uint8_t>& palette,
+                        const vector<uint8_t>& alpha, int level, Filter filter, uint32_t threads, vector<uint8_t>& out,
+                        string& error, const atomic<bool>* cancelled) {
+	if (indices.size() != size_t(width) * height || palette.empty() || palette.size() > 256 * 3) {
+		error = "invalid indexed image";
+		return false;
+	}
+
+	Rows rows = {
+		width, height, 1, 3,
+		[&](size_t y, uint8_t* dst) {
+			memcpy(dst, &indices[y * width], width);
+		}
+	};
+
+	return Write(rows, &palette[0], palette.size(), alpha.empty() ? NULL : &alpha[0], alpha.size(), level, filter,
+	             threads, out, error, cancelled);
+}
+
+bool Png::ParseFilter(const string& name, Filter& filter) {
+	static const char* names[] = { "none", "sub", "up", "avg", "paeth", "adaptive" };
+
+	for (int i = FILTER_NONE; i <= FILTER_ADAPTIVE; i++) {
+		if (name == names[i]) {
+			filter = static_cast<Filter>(i);
+			return true;
+		}
+	}
+
+	return false;
+}
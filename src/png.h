@@ -0,0 +1,66 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+#ifndef __RIBS_PNG_H__
+#define __RIBS_PNG_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cv.h>
+
+namespace ribs {
+
+/**
+ * Direct PNG writer, for what OpenCV does not do: using more than one core.
+ */
+class Png {
+public:
+	/**
+	 * Row filters, `FILTER_ADAPTIVE` picking the best one for each row.
+	 */
+	enum Filter {
+		FILTER_NONE = 0,
+		FILTER_SUB,
+		FILTER_UP,
+		FILTER_AVG,
+		FILTER_PAETH,
+		FILTER_ADAPTIVE
+	};
+
+	/**
+	 * Encodes an 8 bits image, with 1 to 4 channels, to PNG.
+	 *
+	 * Rows are filtered in parallel, then split in chunks compressed in parallel, pigz style: each chunk is primed with
+	 * the last 32KB of the previous one as dictionary and flushed on a byte boundary, so that chunks concatenated
+	 * together form a single standard zlib stream. `threads` is the maximum number of threads, `0` using one per core.
+	 * Either way, cores are shared evenly among images being encoded at the same time.
+	 *
+	 * `cancelled` is checked between bands of rows and between chunks, encoding fails with a `cancelled` error if it
+	 * gets set.
+	 */
+	static bool Encode(const cv::Mat& mat, int level, Filter filter, uint32_t threads,
+	                   std::vector<uint8_t>& out, std::string& error, const std::atomic<bool>* cancelled = NULL);
+
+	/**
+	 * Encodes an indexed image to PNG, `palette` holding RGB triplets and `alpha` optional alpha values of the first
+	 * palette entries.
+	 */
+	static bool EncodeIndexed(const std::vector<uint8_t>& indices, uint32_t width, uint32_t height,
+	                          const std::vector<uint8_t>& palette, const std::vector<uint8_t>& alpha, int level,
+	                          Filter filter, uint32_t threads, std::vector<uint8_t>& out, std::string& error,
+	                          const std::atomic<bool>* cancelled = NULL);
+
+	/**
+	 * Parses a filter name: `none`, `sub`, `up`, `avg`, `paeth` or `adaptive`.
+	 */
+	static bool ParseFilter(const std::string& name, Filter& filter);
+};
+
+}
+
+#endif
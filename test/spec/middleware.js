@@ -13,6 +13,7 @@
 var request = require('supertest'),
 	Test = request.Test,
 	express = require('express'),
+	http = require('http'),
 	path = require('path'),
 	ribs = require('../..'),
 	fs = require('fs');
@@ -21,7 +22,9 @@ var request = require('supertest'),
  * Tests constants.
  */
 
-var ROOT_DIR = require('ribs-fixtures').path;
+var ROOT_DIR = require('ribs-fixtures').path,
+	ORIGIN_PORT = 1338,
+	ORIGIN_URL = 'http://localhost:' + ORIGIN_PORT + '/originals';
 
 /**
  * Test suite.
@@ -29,7 +32,7 @@ var ROOT_DIR = require('ribs-fixtures').path;
 
 describe('express middleware', function() {
 
-	after(function() {
+	after(function(done) {
 		// xxx: i'm so dirty and i like it
 		// remove all cache directories with 2 characters
 		(function rmdir(dir) {
@@ -51,6 +54,16 @@ describe('express middleware', function() {
 			if (dir != ROOT_DIR)
 				fs.rmdirSync(dir);
 		})();
+
+		// processed images store, closed first as it holds its segments open
+		ribs.middleware.close(function(err) {
+			var storeDir = path.join(ROOT_DIR, '.ribs');
+			fs.readdirSync(storeDir).forEach(function(name) {
+				fs.unlinkSync(path.join(storeDir, name));
+			});
+			fs.rmdirSync(storeDir);
+			done(err);
+		});
 	});
 
 	it('should serve an existing image', function(done) {
@@ -111,6 +124,13 @@ describe('express middleware', function() {
 			}, done);
 		});
 
+		it('should handle sharpen', function(done) {
+			server(ROOT_DIR).get('/resize/100/s80_1_2/lena.bmp').expectImage({
+				width: 100,
+				height: 100
+			}, done);
+		});
+
 	});
 
 	describe('cropping', function() {
@@ -143,6 +163,351 @@ describe('express middleware', function() {
 
 	});
 
+	describe('origin', function() {
+		var origin, requests;
+
+		before(function(done) {
+			// stand-in for an upstream server, supporting conditional requests
+			origin = http.createServer(function(req, res) {
+				var filename = path.join(ROOT_DIR, path.basename(req.url));
+
+				requests.push(req);
+
+				// connection lost in the middle of the body
+				if (/truncated/.test(req.url)) {
+					res.setHeader('ETag', '"truncated"');
+					res.setHeader('Content-Length', 1000);
+					res.write(new Buffer(100));
+					return setTimeout(function() { res.socket.destroy(); }, 10);
+				}
+
+				// way too long to respond
+				if (/slow/.test(req.url))
+					return setTimeout(function() { res.end(); }, 200);
+
+				fs.stat(filename, function(err, stat) {
+					if (err) {
+						res.statusCode = 404;
+						return res.end();
+					}
+
+					var etag = '"' + stat.size + '-' + stat.mtime.getTime() + '"';
+					res.setHeader('ETag', etag);
+
+					if (etag == req.headers['if-none-match']) {
+						res.statusCode = 304;
+						return res.end();
+					}
+
+					fs.createReadStream(filename).pipe(res);
+				});
+			});
+			origin.listen(ORIGIN_PORT, done);
+		});
+
+		beforeEach(function() {
+			requests = [];
+		});
+
+		after(function(done) {
+			origin.close(done);
+		});
+
+		it('should fetch the source from the origin', function(done) {
+			server({ root: ROOT_DIR, origin: ORIGIN_URL }).get('/r/120/lena.bmp').expectImage({
+				width: 120,
+				height: 120
+			}, function(err) {
+				if (err) return done(err);
+				requests.should.have.lengthOf(1);
+				requests[0].url.should.equal('/originals/lena.bmp');
+				done();
+			});
+		});
+
+		it('should revalidate a cached source', function(done) {
+			var middleware = ribs.middleware({ root: ROOT_DIR, origin: ORIGIN_URL });
+
+			request(app(middleware)).get('/r/110/lena.bmp').expect(200, function(err) {
+				if (err) return done(err);
+
+				request(app(middleware)).get('/r/90/lena.bmp').expectImage({
+					width: 90,
+					height: 90
+				}, function(err) {
+					if (err) return done(err);
+					requests.should.have.lengthOf(2);
+					should.not.exist(requests[0].headers['if-none-match']);
+					should.exist(requests[1].headers['if-none-match']);
+					done();
+				});
+			});
+		});
+
+		it('should send 404 for an image unknown to the origin', function(done) {
+			server({ root: ROOT_DIR, origin: ORIGIN_URL }).get('/r/100/kahzix.bmp')
+				.expect(404, done);
+		});
+
+		it('should not cache a truncated source', function(done) {
+			var middleware = ribs.middleware({ root: ROOT_DIR, origin: ORIGIN_URL });
+
+			request(app(middleware)).get('/r/100/truncated.bmp').expect(502, function(err) {
+				if (err) return done(err);
+
+				request(app(middleware)).get('/r/100/truncated.bmp').expect(502, function(err) {
+					if (err) return done(err);
+					requests.should.have.lengthOf(2);
+					should.not.exist(requests[1].headers['if-none-match']);
+					done();
+				});
+			});
+		});
+
+		it('should not fetch outside of the origin base path', function(done) {
+			server({ root: ROOT_DIR, origin: ORIGIN_URL }).get('/r/100/%2e%2e').expect(404, function(err) {
+				if (err) return done(err);
+				requests.should.have.lengthOf(0);
+				done();
+			});
+		});
+
+		it('should send 502 when the origin is unreachable', function(done) {
+			server({ root: ROOT_DIR, origin: 'http://localhost:1' }).get('/r/100/lena.bmp')
+				.expect(502, done);
+		});
+
+		it('should send 504 when the origin does not respond in time', function(done) {
+			server({ root: ROOT_DIR, origin: ORIGIN_URL, timeout: 50 }).get('/r/100/slow.bmp')
+				.expect(504, done);
+		});
+
+		it('should reuse connections to the origin', function(done) {
+			var middleware = ribs.middleware({ root: ROOT_DIR, origin: ORIGIN_URL });
+
+			request(app(middleware)).get('/r/70/lena.bmp').expect(200, function(err) {
+				if (err) return done(err);
+
+				request(app(middleware)).get('/r/60/lena.bmp').expect(200, function(err) {
+					if (err) return done(err);
+					requests.should.have.lengthOf(2);
+					requests[1].socket.should.equal(requests[0].socket);
+					done();
+				});
+			});
+		});
+
+		it('should serve a stored image once its source is revalidated', function(done) {
+			var middleware = ribs.middleware({ root: ROOT_DIR, origin: ORIGIN_URL, cacheSize: 0 });
+
+			request(app(middleware)).get('/r/33/lena.bmp').expect(200, function(err) {
+				if (err) return done(err);
+
+				var spy = sinon.spy(ribs.Pipeline.prototype, 'enqueue');
+
+				request(app(middleware)).get('/r/33/lena.bmp').expectImage({
+					width: 33,
+					height: 33
+				}, function(err) {
+					spy.restore();
+					if (err) return done(err);
+					spy.should.not.have.been.called;
+					requests.should.have.lengthOf(2);
+					should.exist(requests[1].headers['if-none-match']);
+					done();
+				});
+			});
+		});
+
+	});
+
+	describe('plans', function() {
+
+		it('should serve the same url twice', function(done) {
+			var middleware = ribs.middleware(ROOT_DIR);
+
+			request(app(middleware)).get('/r/80/lena.bmp').expect(200, function(err) {
+				if (err) return done(err);
+
+				request(app(middleware)).get('/r/80/lena.bmp').expectImage({
+					width: 80,
+					height: 80
+				}, done);
+			});
+		});
+
+		it('should serve different sources with the same operations', function(done) {
+			var middleware = ribs.middleware(ROOT_DIR);
+
+			request(app(middleware)).get('/r/4/0124.png').expect(200, function(err) {
+				if (err) return done(err);
+
+				request(app(middleware)).get('/r/4/lena.bmp').expectImage({
+					width: 4,
+					height: 4
+				}, done);
+			});
+		});
+
+		it('should reject an invalid url twice', function(done) {
+			var middleware = ribs.middleware(ROOT_DIR);
+
+			request(app(middleware)).get('/resize/xxx/lena.bmp').expect(400, function(err) {
+				if (err) return done(err);
+				request(app(middleware)).get('/resize/xxx/lena.bmp').expect(400, done);
+			});
+		});
+
+		it('should give a fresh error on each request', function(done) {
+			var errors = [],
+				middleware = ribs.middleware(ROOT_DIR),
+				record = function(err, req, res, next) {
+					errors.push(err);
+					next(err);
+				};
+
+			request(app(middleware, record)).get('/resize/xxx/lena.bmp').expect(400, function(err) {
+				if (err) return done(err);
+
+				request(app(middleware, record)).get('/resize/xxx/lena.bmp').expect(400, function(err) {
+					if (err) return done(err);
+					errors.should.have.lengthOf(2);
+					errors[0].should.not.equal(errors[1]);
+					errors[1].message.should.equal(errors[0].message);
+					done();
+				});
+			});
+		});
+
+		it('should not evict valid plans with invalid urls', function(done) {
+			var middleware = ribs.middleware({ root: ROOT_DIR, plans: 1 });
+
+			request(app(middleware)).get('/r/60/lena.bmp').expect(200, function(err) {
+				if (err) return done(err);
+
+				request(app(middleware)).get('/resize/xxx/lena.bmp').expect(400, function(err) {
+					if (err) return done(err);
+
+					var spy = sinon.spy(ribs.Pipeline, 'compile');
+
+					request(app(middleware)).get('/r/60/0124.png').expect(200, function(err) {
+						spy.restore();
+						if (err) return done(err);
+						spy.should.not.have.been.called;
+						done();
+					});
+				});
+			});
+		});
+
+		it('should pass an unknown operation twice', function(done) {
+			var middleware = ribs.middleware(ROOT_DIR);
+
+			request(app(middleware)).get('/rresize/100/lena.bmp').expect(404, function(err) {
+				if (err) return done(err);
+				request(app(middleware)).get('/rresize/100/lena.bmp').expect(404, done);
+			});
+		});
+
+	});
+
+	describe('store', function() {
+		var CHANGING_IMAGE = path.join(ROOT_DIR, 'changing.png');
+
+		after(function() {
+			if (fs.existsSync(CHANGING_IMAGE)) fs.unlinkSync(CHANGING_IMAGE);
+		});
+
+		it('should send stored images straight to the socket', function(done) {
+			var middleware = ribs.middleware(ROOT_DIR);
+
+			request(app(middleware)).get('/r/72/lena.bmp').expect(200, function(err) {
+				if (err) return done(err);
+
+				var spy = sinon.spy(ribs.Store.prototype, 'send');
+
+				request(app(middleware)).get('/r/72/lena.bmp').expectImage({
+					width: 72,
+					height: 72
+				}, function(err) {
+					spy.restore();
+					if (err) return done(err);
+					spy.should.have.been.calledOnce;
+					done();
+				});
+			});
+		});
+
+		it('should process a changed source again', function(done) {
+			var middleware = ribs.middleware(ROOT_DIR);
+
+			fs.writeFileSync(CHANGING_IMAGE, fs.readFileSync(path.join(ROOT_DIR, '0124.png')));
+
+			request(app(middleware)).get('/r/4/changing.png').expect(200, function(err) {
+				if (err) return done(err);
+
+				// another size, whatever the modification time resolution
+				fs.writeFileSync(CHANGING_IMAGE, fs.readFileSync(path.join(ROOT_DIR, '0124a.png')));
+
+				var spy = sinon.spy(ribs.Pipeline.prototype, 'enqueue');
+
+				request(app(middleware)).get('/r/4/changing.png').expect(200, function(err) {
+					spy.restore();
+					if (err) return done(err);
+					spy.should.have.been.calledOnce;
+					done();
+				});
+			});
+		});
+
+		it('should serve a processed image from the store', function(done) {
+			var middleware = ribs.middleware(ROOT_DIR);
+
+			request(app(middleware)).get('/r/70/lena.bmp').expect(200, function(err) {
+				if (err) return done(err);
+
+				var spy = sinon.spy(ribs.Pipeline.prototype, 'enqueue');
+
+				request(app(middleware)).get('/r/70/lena.bmp').expectImage({
+					width: 70,
+					height: 70
+				}, function(err) {
+					spy.restore();
+					if (err) return done(err);
+					spy.should.not.have.been.called;
+					done();
+				});
+			});
+		});
+
+		it('should serve the same operations from the store whatever their aliases', function(done) {
+			var middleware = ribs.middleware(ROOT_DIR);
+
+			request(app(middleware)).get('/resize/50/lena.bmp').expect(200, function(err) {
+				if (err) return done(err);
+
+				var spy = sinon.spy(ribs.Pipeline.prototype, 'enqueue');
+
+				request(app(middleware)).get('/r/50/lena.bmp').expectImage({
+					width: 50,
+					height: 50
+				}, function(err) {
+					spy.restore();
+					if (err) return done(err);
+					spy.should.not.have.been.called;
+					done();
+				});
+			});
+		});
+
+		it('should write processed images in segments', function() {
+			fs.readdirSync(path.join(ROOT_DIR, '.ribs')).filter(function(name) {
+				return /\.seg$/.test(name);
+			}).should.not.be.empty;
+		});
+
+	});
+
 	describe('order', function() {
 
 		it('should call operations in order', function(done) {
@@ -204,12 +569,17 @@ Test.prototype.expectImage = function(expect, done) {
 };
 
 function server(options) {
+	return request(app(ribs.middleware(options)));
+}
+
+function app(middleware, errorMiddleware) {
 	var app = express();
-	app.use(ribs.middleware(options));
+	app.use(middleware);
 	app.use(express.static(ROOT_DIR));
+	if (errorMiddleware) app.use(errorMiddleware);
 	app.use(express.errorHandler());
 
-	return request(app);
+	return app;
 }
 
 function binaryParser(res, callback) {
@@ -10,6 +10,8 @@ require('./pipeline');
 require('./ribs');
 require('./stream');
 require('./utils');
+require('./pyramid');
+require('./store');
 require('./operations/from');
 require('./operations/to');
 require('./operations/resize');
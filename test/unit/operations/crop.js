@@ -14,13 +14,17 @@ var ribs = require('../../..'),
 	Image = ribs.Image,
 	from = ribs.operations.from,
 	crop = ribs.operations.crop,
+	fs = require('fs'),
 	path = require('path');
 
 /**
  * Tests constants.
  */
 
-var SRC_IMAGE = path.join(require('ribs-fixtures').path, '0124.png'),
+var SRC_DIR = require('ribs-fixtures').path,
+	SRC_IMAGE = path.join(SRC_DIR, '0124.png'),
+	SRC_JPEG = path.join(SRC_DIR, '01100.jpg'),
+	TMP_DIR = path.join(SRC_DIR, 'tmp/'),
 	W = 8,
 	H = 8,
 	W_2 = W / 2,
@@ -290,4 +294,112 @@ describe('crop operation', function() {
 			{ width: 5, height: H }
 		]));
 	});
-});
\ No newline at end of file
+
+	describe('lossless', function() {
+		var spy;
+
+		before(function() {
+			try { fs.mkdirSync(TMP_DIR); }
+			catch(err) { /* let cry */ }
+		});
+
+		after(function() {
+			try { fs.rmdirSync(TMP_DIR); }
+			catch(err) { /* let cry */ }
+		});
+
+		beforeEach(function() {
+			spy = sinon.spy(Image, 'cropJpeg');
+		});
+
+		afterEach(function() {
+			spy.restore();
+		});
+
+		var testLossless = curry(function(dst, expectLossless, done) {
+			var finalParams;
+			dst = path.join(TMP_DIR, dst);
+
+			ribs.from(SRC_JPEG).crop({ width: W_2, height: H_2, x: 3, y: 3, anchor: 'tl' }).to(dst)
+				.on('operation:after', function(name, params) {
+					if ('crop' == name) finalParams = params;
+				})
+				.done(function(err, image) {
+					should.not.exist(err);
+					spy.called.should.equal(expectLossless);
+
+					image.should.have.property('width', W_2);
+					image.should.have.property('height', H_2);
+
+					// origin is snapped to the MCU grid
+					if (expectLossless) {
+						(finalParams.x % 8).should.equal(0);
+						(finalParams.y % 8).should.equal(0);
+					}
+
+					from(dst, function(err, saved) {
+						should.not.exist(err);
+						saved.should.have.property('width', W_2);
+						saved.should.have.property('height', H_2);
+						fs.unlinkSync(dst);
+						done();
+					});
+				});
+		});
+
+		it('should crop a jpg to a jpg losslessly', testLossless('01100-crop.jpg', true));
+
+		it('should not crop losslessly when transcoding', testLossless('01100-crop.png', false));
+
+		it('should not decode pixels when cropping losslessly', function(done) {
+			var dst = path.join(TMP_DIR, '01100-crop-nodecode.jpg'),
+				load = sinon.spy(Image.prototype, 'load'),
+				pixels = sinon.spy(Image.prototype, 'crop');
+
+			ribs.from(SRC_JPEG).crop({ width: W_2, height: H_2 }).to(dst).done(function(err, image) {
+				load.restore();
+				pixels.restore();
+				should.not.exist(err);
+				spy.should.have.been.calledOnce;
+				load.should.not.have.been.called;
+				pixels.should.not.have.been.called;
+				image.should.have.lengthOf(0);
+				fs.unlinkSync(dst);
+				done();
+			});
+		});
+
+		it('should not crop losslessly when quality changes', function(done) {
+			var dst = path.join(TMP_DIR, '01100-crop-q50.jpg');
+
+			ribs.from(SRC_JPEG).crop({ width: W_2, height: H_2 }).to({ dst: dst, quality: 50 }).done(function(err) {
+				should.not.exist(err);
+				spy.called.should.be.false;
+				fs.unlinkSync(dst);
+				done();
+			});
+		});
+
+		it('should not crop losslessly when searching a byte budget', function(done) {
+			var dst = path.join(TMP_DIR, '01100-crop-budget.jpg');
+
+			ribs.from(SRC_JPEG).crop({ width: W_2, height: H_2 }).to({ dst: dst, maxBytes: 100000 }).done(function(err) {
+				should.not.exist(err);
+				spy.called.should.be.false;
+				fs.unlinkSync(dst);
+				done();
+			});
+		});
+
+		it('should not crop losslessly when other operations are involved', function(done) {
+			var dst = path.join(TMP_DIR, '01100-crop-resize.jpg');
+
+			ribs.from(SRC_JPEG).crop({ width: W_2, height: H_2 }).resize(W_2 / 2).to(dst).done(function(err) {
+				should.not.exist(err);
+				spy.called.should.be.false;
+				fs.unlinkSync(dst);
+				done();
+			});
+		});
+	});
+});
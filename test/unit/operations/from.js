@@ -153,9 +153,7 @@ describe('from operation', function() {
 		it('should work with interlaced 24-bit with alpha channel', test('0124ai.png', null, true));
 	});
 
-	// gif are not supported by OCV
-	//   http://stackoverflow.com/questions/11494119/error-in-opencv-2-4-2-opencv-error-bad-flag
-	xdescribe('with gif files', function() {
+	describe('with gif files', function() {
 		it('should work with standard', test('01.gif', null, false));
 
 		it('should work with interlaced', test('01i.gif', null, false));
@@ -163,5 +161,82 @@ describe('from operation', function() {
 		it('should work with with alpha channel', test('01a.gif', null, true));
 
 		it('should work with interlaced with alpha channel', test('01ai.gif', null, true));
+
+		it('should tell a still gif is not animated', function(done) {
+			from(path.join(SRC_DIR, '01.gif'), function(err, image) {
+				should.not.exist(err);
+				image.animated.should.be.false;
+				should.not.exist(image.animation);
+				done();
+			});
+		});
+	});
+
+	describe('when the pipeline writes the image', function() {
+		var SRC_IMAGE = path.join(SRC_DIR, '0124.png');
+
+		it('should decode pixels for custom operations', function(done) {
+			var dst = new Buffer(fs.statSync(SRC_IMAGE).size);
+
+			ribs.from(SRC_IMAGE).use(function(params, image, next) {
+				image.should.have.lengthOf(8 * 8 * 3);
+				next(null, image);
+			}).to({ dst: dst, format: 'png' }).done(function(err) {
+				should.not.exist(err);
+				done();
+			});
+		});
+
+		it('should neither decode nor encode an untouched image', function(done) {
+			var decode = sinon.spy(Image, 'decode'),
+				load = sinon.spy(Image.prototype, 'load'),
+				encode = sinon.spy(Image.prototype, 'encode'),
+				dst = new Buffer(fs.statSync(SRC_IMAGE).size);
+
+			ribs.from(SRC_IMAGE).to({ dst: dst, format: 'png' }).done(function(err, image) {
+				decode.restore();
+				load.restore();
+				encode.restore();
+				should.not.exist(err);
+				decode.should.not.have.been.called;
+				load.should.not.have.been.called;
+				encode.should.not.have.been.called;
+				image.should.have.property('width', 8);
+				image.should.have.property('height', 8);
+				image.should.have.lengthOf(0);
+				dst.should.eql(fs.readFileSync(SRC_IMAGE));
+				done();
+			});
+		});
+
+		it('should give header dimensions to hooks', function(done) {
+			var load = sinon.spy(Image.prototype, 'load'),
+				dst = new Buffer(1024);
+
+			ribs.from(SRC_IMAGE).resize({ width: 8, height: 8 }).to({ dst: dst, format: 'png' })
+				.done(function(err, image) {
+					load.restore();
+					should.not.exist(err);
+					load.should.not.have.been.called;
+					image.should.have.property('width', 8);
+					done();
+				});
+		});
+
+		it('should decode pixels before touching them', function(done) {
+			var load = sinon.spy(Image.prototype, 'load'),
+				dst = new Buffer(1024);
+
+			ribs.from(SRC_IMAGE).resize(4).to({ dst: dst, format: 'bmp' }).done(function(err, image) {
+				load.restore();
+				should.not.exist(err);
+				load.should.have.been.calledOnce;
+				image.should.have.property('width', 4);
+				image.should.have.property('height', 4);
+				image.should.have.lengthOf(4 * 4 * 3);
+				should.not.exist(image.pending);
+				done();
+			});
+		});
 	});
 });
\ No newline at end of file
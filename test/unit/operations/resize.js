@@ -21,6 +21,7 @@ var ribs = require('../../..'),
  */
 
 var SRC_IMAGE = path.join(require('ribs-fixtures').path, '0124.png'),
+	EDGES_IMAGE = path.join(require('ribs-fixtures').path, 'lena.bmp'),
 	W = 8, H = 8,
 	W_2 = W / 2, H_2 = H / 2,
 	W_3 = Math.round(W / 3), H_3 = Math.round(H / 3);
@@ -58,6 +59,42 @@ var test = curry(function(params, expect, done) {
 	});
 });
 
+/**
+ * Resizes a fresh decode of `src` twice, with and without params, and gives both results.
+ */
+var resizeBoth = function(src, params, otherParams, callback) {
+	from(src, function(err, image) {
+		should.not.exist(err);
+
+		resize(params, image, function(err, image) {
+			should.not.exist(err);
+
+			from(src, function(err, other) {
+				should.not.exist(err);
+
+				resize(otherParams, other, function(err, other) {
+					should.not.exist(err);
+					callback(image, other);
+				});
+			});
+		});
+	});
+};
+
+/**
+ * Sums absolute differences between horizontal neighbours, higher when edges are sharper.
+ */
+var edgeContrast = function(image) {
+	var total = 0, stride = image.width * image.channels;
+
+	for (var y = 0; y < image.height; y++) {
+		for (var x = image.channels; x < stride; x++)
+			total += Math.abs(image[y * stride + x] - image[y * stride + x - image.channels]);
+	}
+
+	return total;
+};
+
 /**
  *
  * @param expect
@@ -122,6 +159,10 @@ describe('resize operation', function() {
 			'height', ['number', 'string'], true, {}
 		));
 
+		it('should fail when params.sharpen has an invalid type', testParams(
+			'sharpen', ['string', 'object'], true, {}
+		));
+
 		it('should fail when image has an invalid type', testImage());
 
 		it('should fail when image is not an instance of Image', function(done) {
@@ -284,4 +325,85 @@ describe('resize operation', function() {
 			{ width: 5, height: 5 }
 		]));
 	});
-});
\ No newline at end of file
+
+	describe('with sharpen params', function() {
+		it('should resize and sharpen', test({ width: W_2, height: H_2, sharpen: 's80' }, {
+			width: W_2, height: H_2
+		}));
+
+		it('should resize and blur', test({ width: W_2, height: H_2, sharpen: { amount: -100, radius: 2 } }, {
+			width: W_2, height: H_2
+		}));
+
+		it('should accept a sharpen specification in params as an array', test([W_2, 's80_1_2'], {
+			width: W_2, height: H_2
+		}));
+
+		it('should sharpen even when size is the same as original one', function(done) {
+			from(SRC_IMAGE, function(err, image) {
+				var spy = sinon.spy(image, 'resize');
+
+				resize({ sharpen: 's200' }, image, function(err, image) {
+					should.not.exist(err);
+					spy.should.have.been.calledWith(W, H, 2, 1, 0);
+					image.should.have.property('width', W);
+					image.should.have.property('height', H);
+					done();
+				});
+			});
+		});
+
+		it('should increase edge contrast', function(done) {
+			resizeBoth(EDGES_IMAGE, { width: 256, sharpen: 's150' }, { width: 256 }, function(sharpened, plain) {
+				edgeContrast(sharpened).should.be.above(edgeContrast(plain));
+				done();
+			});
+		});
+
+		it('should decrease edge contrast when blurring', function(done) {
+			resizeBoth(EDGES_IMAGE, { width: 256, sharpen: { amount: -100, radius: 2 } }, { width: 256 },
+				function(blurred, plain) {
+					edgeContrast(blurred).should.be.below(edgeContrast(plain));
+					done();
+				}
+			);
+		});
+
+		it('should leave pixels untouched when amount is 0', function(done) {
+			resizeBoth(EDGES_IMAGE, { width: 256, sharpen: 's0' }, { width: 256 }, function(image, plain) {
+				image.should.have.lengthOf(plain.length);
+				for (var i = 0, len = image.length; i < len; i++)
+					image[i].should.equal(plain[i]);
+				done();
+			});
+		});
+
+		it('should leave pixels untouched when native amount is 0', function(done) {
+			from(EDGES_IMAGE, function(err, image) {
+				from(EDGES_IMAGE, function(err, plain) {
+					var w = image.width / 2, h = image.height / 2;
+
+					image.resize(w, h, 0, 1, 0, function(err, image) {
+						should.not.exist(err);
+
+						plain.resize(w, h, function(err, plain) {
+							should.not.exist(err);
+							for (var i = 0, len = image.length; i < len; i++)
+								image[i].should.equal(plain[i]);
+							done();
+						});
+					});
+				});
+			});
+		});
+
+		it('should fail when sharpen is invalid', function(done) {
+			from(SRC_IMAGE, function(err, image) {
+				resize({ width: W_2, sharpen: 'sxx' }, image, function(err) {
+					helpers.checkError(err, 'invalid sharpen: sxx');
+					done();
+				});
+			});
+		});
+	});
+});
@@ -14,6 +14,7 @@ var ribs = require('../../..'),
 	Image = ribs.Image,
 	from = ribs.operations.from,
 	to = ribs.operations.to,
+	resize = ribs.operations.resize,
 	fs = require('fs'),
 	http = require('http'),
 	path = require('path');
@@ -25,6 +26,13 @@ var ribs = require('../../..'),
 var SRC_DIR = require('ribs-fixtures').path,
 	TMP_DIR = path.join(SRC_DIR, 'tmp/');
 
+// 8x8, 2 frames, the second one being a 4x4 square in the middle
+var ANIMATED_GIF = new Buffer(
+	'R0lGODlhCAAIAPEAAP8AAAD/AAAA/////yH/C05FVFNDQVBFMi4wAwEAAAAh+QQECgAAACwAAAAACAAIAAACMQRBEAzDMARBEAzDMARBEAzD' +
+	'MARBEAzDMAzDMARBEAzDMARBEAzDMARBEAzDMARBEAUAIfkEBAoAAAAsAgACAAQABAAAAg0URVEURVEURVEURVEFADs=',
+	'base64'
+);
+
 /**
  * Tests helper functions.
  */
@@ -238,9 +246,103 @@ describe('to operation', function() {
 		}));
 	});
 
-	// gif are not supported by OCV
-	//   http://stackoverflow.com/questions/11494119/error-in-opencv-2-4-2-opencv-error-bad-flag
-	xdescribe('with gif files', function() {
+	describe('png filters', function() {
+		['none', 'sub', 'up', 'avg', 'paeth', 'adaptive'].forEach(function(filter) {
+			it('should save with ' + filter + ' filter', test('0124.png', {
+				dst: path.join(TMP_DIR, '0124-' + filter + '.png'),
+				filter: filter
+			}));
+		});
+
+		it('should save with alpha channel', test('0124a.png', {
+			filter: 'paeth'
+		}));
+
+		it('should fail when params.filter has an invalid type', testParams(
+			'filter', ['string'], true, { dst: '' }
+		));
+
+		it('should fail when filter is unknown', function(done) {
+			var dst = path.join(TMP_DIR, 'filter.png');
+
+			from(path.join(SRC_DIR, '0124.png'), function(err, image) {
+				to({ dst: dst, filter: 'NaNaNaN' }, image, function(err) {
+					if (fs.existsSync(dst)) fs.unlinkSync(dst);
+					helpers.checkError(err, 'invalid filter: NaNaNaN');
+					done();
+				});
+			});
+		});
+	});
+
+	describe('palette', function() {
+		it('should save with 256 colors', test('0124.png', {
+			dst: path.join(TMP_DIR, '0124-256.png'),
+			colors: 256
+		}));
+
+		it('should save with 16 dithered colors', test('0124.png', {
+			dst: path.join(TMP_DIR, '0124-16.png'),
+			colors: 16,
+			dither: true
+		}));
+
+		it('should save with alpha channel', test('0124a.png', {
+			colors: 64
+		}));
+
+		it('should save smaller than truecolor', function(done) {
+			var dst = path.join(TMP_DIR, 'lena-palette.png');
+
+			from(path.join(SRC_DIR, 'lena.bmp'), function(err, image) {
+				to({ dst: dst, format: 'png' }, image, function(err) {
+					should.not.exist(err);
+					var truecolor = fs.statSync(dst).size;
+
+					to({ dst: dst, format: 'png', colors: 64 }, image, function(err) {
+						should.not.exist(err);
+						fs.statSync(dst).size.should.be.below(truecolor);
+						fs.unlinkSync(dst);
+						done();
+					});
+				});
+			});
+		});
+
+		it('should fail when params.colors has an invalid type', testParams(
+			'colors', ['number'], true, { dst: '' }
+		));
+
+		it('should fail when params.dither has an invalid type', testParams(
+			'dither', ['boolean'], true, { dst: '' }
+		));
+
+		it('should fail when format is not png nor gif', function(done) {
+			var dst = path.join(TMP_DIR, 'palette.jpg');
+
+			from(path.join(SRC_DIR, '0124.png'), function(err, image) {
+				to({ dst: dst, colors: 16 }, image, function(err) {
+					if (fs.existsSync(dst)) fs.unlinkSync(dst);
+					helpers.checkError(err, 'invalid colors: only applies to png and gif');
+					done();
+				});
+			});
+		});
+
+		it('should fail when colors is out of range', function(done) {
+			var dst = path.join(TMP_DIR, 'palette.png');
+
+			from(path.join(SRC_DIR, '0124.png'), function(err, image) {
+				to({ dst: dst, colors: 1000 }, image, function(err) {
+					if (fs.existsSync(dst)) fs.unlinkSync(dst);
+					helpers.checkError(err, 'invalid colors: must be between 2 and 256');
+					done();
+				});
+			});
+		});
+	});
+
+	describe('with gif files', function() {
 		it('should save standard', test('01.gif', {
 			quality: 0
 		}));
@@ -256,6 +358,67 @@ describe('to operation', function() {
 		it('should save interlaced with alpha channel', test('01ai.gif', {
 			quality: 0
 		}));
+
+		it('should save a png as gif', test('0124.png', {
+			dst: path.join(TMP_DIR, '0124-to.gif')
+		}));
+
+		it('should save a png with alpha channel as gif', test('0124a.png', {
+			dst: path.join(TMP_DIR, '0124a-to.gif')
+		}));
+
+		it('should save with 64 colors', test('0124.png', {
+			dst: path.join(TMP_DIR, '0124-64.gif'),
+			colors: 64
+		}));
+	});
+
+	describe('with animated gif files', function() {
+		var animate = function(params, check) {
+			return function(done) {
+				var dst = path.join(TMP_DIR, 'animated-to.' + (params.format || 'gif'));
+
+				from(ANIMATED_GIF, function(err, image) {
+					should.not.exist(err);
+					image.animated.should.be.true;
+
+					resize(params.resize, image, function(err, image) {
+						should.not.exist(err);
+
+						to({ dst: dst, format: params.format }, image, function(err) {
+							should.not.exist(err);
+
+							from(dst, function(err, savedImage) {
+								should.not.exist(err);
+								check(savedImage);
+								fs.unlinkSync(dst);
+								done();
+							});
+						});
+					});
+				});
+			};
+		};
+
+		it('should resize every frame', animate({ resize: { width: 4, height: 4 } }, function(image) {
+			image.should.have.property('width', 4);
+			image.should.have.property('height', 4);
+			image.animated.should.be.true;
+		}));
+
+		it('should save the first frame only to other formats', animate({
+			resize: { width: 4, height: 4 }, format: 'png'
+		}, function(image) {
+			image.should.have.property('width', 4);
+			image.should.have.property('originalFormat', 'png');
+		}));
+
+		it('should save the first frame only when sharpened', animate({
+			resize: { width: 4, height: 4, sharpen: 's80' }
+		}, function(image) {
+			image.should.have.property('width', 4);
+			image.animated.should.be.false;
+		}));
 	});
 
 	describe('format handling', function() {
@@ -273,4 +436,123 @@ describe('to operation', function() {
 		}));
 
 	});
+
+	describe('pass-through', function() {
+
+		var testPassThrough = curry(function(src, params, identical, alter, done) {
+			var dst = path.join(TMP_DIR, src.replace(/\.(jpg|png)$/, '-pass.$1'));
+			src = path.join(SRC_DIR, src);
+			params.dst = dst;
+
+			from(src, function(err, image) {
+				should.not.exist(err);
+				alter(image);
+
+				to(params, image, function(err) {
+					should.not.exist(err);
+
+					var same = fs.readFileSync(src).toString('hex') == fs.readFileSync(dst).toString('hex');
+					same.should.equal(identical);
+
+					fs.unlinkSync(dst);
+					done();
+				});
+			});
+		});
+
+		it('should write original bytes when nothing changed', testPassThrough(
+			'01100.jpg', {}, true, _.noop
+		));
+
+		it('should encode when quality is specified', testPassThrough(
+			'01100.jpg', { quality: 50 }, false, _.noop
+		));
+
+		it('should encode when format changes', testPassThrough(
+			'0124.png', { format: 'jpg' }, false, _.noop
+		));
+
+		it('should encode when pixels changed', testPassThrough(
+			'0124.png', {}, false, function(image) {
+				image.map(function(color) { return 255 - color; });
+			}
+		));
+
+		it('should write original bytes when they fit in maxBytes', testPassThrough(
+			'01100.jpg', { maxBytes: 1e7 }, true, _.noop
+		));
+
+	});
+
+	describe('byte budget', function() {
+		var testBudget = curry(function(maxBytes, params, done) {
+			var dst = path.join(TMP_DIR, 'lena-budget.jpg');
+
+			params.dst = dst;
+			params.maxBytes = maxBytes;
+
+			from(path.join(SRC_DIR, 'lena.bmp'), function(err, image) {
+				to(params, image, function(err) {
+					should.not.exist(err);
+
+					fs.statSync(dst).size.should.be.at.most(maxBytes);
+					params.encoded.quality.should.be.within(1, params.quality || 95);
+					params.encoded.trials.should.be.within(1, 8);
+
+					from(dst, function(err, savedImage) {
+						should.not.exist(err);
+						savedImage.should.have.property('width', image.width);
+						fs.unlinkSync(dst);
+						done();
+					});
+				});
+			});
+		});
+
+		it('should fit in the budget', testBudget(20000, {}));
+
+		it('should not exceed quality', testBudget(1e7, { quality: 60 }));
+
+		it('should fail when params.maxBytes has an invalid type', testParams(
+			'maxBytes', ['number'], true, { dst: '' }
+		));
+
+		var testInvalid = curry(function(params, message, done) {
+			var dst = path.join(TMP_DIR, 'budget.jpg');
+
+			params.dst = dst;
+
+			from(path.join(SRC_DIR, 'lena.bmp'), function(err, image) {
+				to(params, image, function(err) {
+					if (fs.existsSync(dst)) fs.unlinkSync(dst);
+					helpers.checkError(err, message);
+					done();
+				});
+			});
+		});
+
+		it('should fail when params.maxBytes is out of range', testInvalid(
+			{ maxBytes: 0x100000001 }, 'invalid maxBytes: must be an integer between 1 and 4294967295'
+		));
+
+		it('should fail when params.maxBytes is not an integer', testInvalid(
+			{ maxBytes: 1000.5 }, 'invalid maxBytes: must be an integer between 1 and 4294967295'
+		));
+
+		it('should fail when progressive', testInvalid(
+			{ maxBytes: 20000, progressive: true }, 'invalid progressive: does not apply with maxBytes'
+		));
+
+		it('should fail when format is not jpg', function(done) {
+			var dst = path.join(TMP_DIR, 'budget.png');
+
+			from(path.join(SRC_DIR, '0124.png'), function(err, image) {
+				to({ dst: dst, maxBytes: 1000 }, image, function(err) {
+					if (fs.existsSync(dst)) fs.unlinkSync(dst);
+					helpers.checkError(err, 'invalid maxBytes: only applies to jpg');
+					done();
+				});
+			});
+		});
+	});
 });
\ No newline at end of file
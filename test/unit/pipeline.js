@@ -16,6 +16,15 @@ var ribs = require('../..'),
 	fs = require('fs'),
 	path = require('path');
 
+/**
+ * Tests constants.
+ */
+
+var SRC_IMAGE = path.join(require('ribs-fixtures').path, '0124.png'),
+	LARGE_IMAGE = path.join(require('ribs-fixtures').path, 'lena.bmp'),
+	W = 8,
+	LARGE_W = 512;
+
 /**
  * Tests helper functions.
  */
@@ -349,4 +358,152 @@ describe('Pipeline', function() {
 
 	});
 
-});
\ No newline at end of file
+
+	describe('source', function() {
+
+		it('should keep original bytes through no-op operations', function(done) {
+			this.pipeline.from(SRC_IMAGE).resize(W * 2).crop().done(function(err, image) {
+				should.not.exist(err);
+				should.exist(image.source);
+				done();
+			});
+		});
+
+		it('should drop original bytes when pixels are changed', function(done) {
+			this.pipeline.from(SRC_IMAGE).resize(W / 2).done(function(err, image) {
+				should.not.exist(err);
+				should.not.exist(image.source);
+				done();
+			});
+		});
+
+		it('should drop original bytes before an inline operation', function(done) {
+			this.pipeline.from(SRC_IMAGE).use(function(params, image, next) {
+				should.not.exist(image.source);
+				next(null, image);
+			}).done(done);
+		});
+
+	});
+
+	describe('abort', function() {
+
+		it('should not invoke operations once aborted', function(done) {
+			var op = add();
+
+			this.pipeline.use(op.name).abort().done(function(err) {
+				err.should.be.instanceof(Error);
+				err.message.should.equal('pipeline aborted');
+				op.spy.should.not.have.been.called;
+				done();
+			});
+		});
+
+		it('should end with the given reason', function(done) {
+			var reason = new Error('client gone');
+
+			this.pipeline.from(SRC_IMAGE).use(function(params, image, next) {
+				this.abort(reason);
+				next(null, image);
+			}).resize(W / 2).done(function(err) {
+				err.should.equal(reason);
+				done();
+			});
+		});
+
+		it('should abort while a native operation runs', function(done) {
+			var pipeline = this.pipeline;
+
+			pipeline.on('operation:before', function(name) {
+				// native resize is enqueued right after this event
+				if ('resize' == name) process.nextTick(pipeline.abort.bind(pipeline));
+			});
+
+			pipeline.from(SRC_IMAGE).resize(W / 2).done(function(err) {
+				err.message.should.equal('pipeline aborted');
+				done();
+			});
+		});
+
+		it('should abort past the deadline', function(done) {
+			this.pipeline.from(SRC_IMAGE).use(function(params, image, next) {
+				setTimeout(next.bind(null, null, image), 50);
+			}).resize(W / 2).deadline(10).done(function(err) {
+				err.message.should.equal('deadline exceeded');
+				err.should.have.property('status', 503);
+				done();
+			});
+		});
+
+		it('should not abort before the deadline', function(done) {
+			this.pipeline.from(SRC_IMAGE).resize(W / 2).deadline(1000).done(function(err) {
+				should.not.exist(err);
+				done();
+			});
+		});
+
+	});
+
+	describe('plans', function() {
+
+		it('should compile and enqueue a bulk', function(done) {
+			var op1 = add(), op2 = add();
+			var plan = Pipeline.compile([{ operation: op1.name }, { operation: op2.name }]);
+
+			this.pipeline.enqueue(plan).done(checkOk([op1, op2], done));
+		});
+
+		it('should enqueue a plan many times', function(done) {
+			var op = add();
+			var plan = Pipeline.compile([{ operation: op.name }]);
+
+			new Pipeline().enqueue(plan).done(function(err) {
+				should.not.exist(err);
+				new Pipeline().enqueue(plan).done(function(err) {
+					should.not.exist(err);
+					op.spy.should.have.been.calledTwice;
+					done();
+				});
+			});
+		});
+
+		it('should override params by operation name', function(done) {
+			var plan = Pipeline.compile([{ operation: 'from' }, { operation: 'resize', params: [W * 2] }]);
+
+			this.pipeline.enqueue(plan, { from: [SRC_IMAGE] }).done(function(err, image) {
+				should.not.exist(err);
+				image.should.have.property('width', W);
+				done();
+			});
+		});
+
+		it('should resolve params again on each run', function(done) {
+			var plan = Pipeline.compile([{ operation: 'from' }, { operation: 'resize', params: { width: 'x50' } }]);
+
+			new Pipeline().enqueue(plan, { from: [SRC_IMAGE] }).done(function(err, image) {
+				should.not.exist(err);
+				image.should.have.property('width', W / 2);
+
+				new Pipeline().enqueue(plan, { from: [LARGE_IMAGE] }).done(function(err, image) {
+					should.not.exist(err);
+					image.should.have.property('width', LARGE_W / 2);
+					plan[1].params.should.eql({ width: 'x50' });
+					done();
+				});
+			});
+		});
+
+		it('should fail to compile an unknown operation', function() {
+			(function() {
+				Pipeline.compile([{ operation: 'NaNaNaN' }]);
+			}).should.throw('no operation found: NaNaNaN');
+		});
+
+		it('should fail to compile duplicates of from', function() {
+			(function() {
+				Pipeline.compile([{ operation: 'from' }, { operation: 'from' }]);
+			}).should.throw('duplicate of from found');
+		});
+
+	});
+});
@@ -0,0 +1,307 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+'use strict';
+
+/**
+ * Module dependencies.
+ */
+
+var ribs = require('../..'),
+	Image = ribs.Image,
+	Pipeline = ribs.Pipeline,
+	Pyramid = ribs.Pyramid,
+	fs = require('fs'),
+	path = require('path');
+
+/**
+ * Tests constants.
+ */
+
+var SRC_DIR = require('ribs-fixtures').path,
+	SRC_IMAGE = path.join(SRC_DIR, 'lena.bmp'),
+	SMALL_IMAGE = path.join(SRC_DIR, '0124.png'),
+	PYRAMID_DIR = path.join(SRC_DIR, 'tmp/pyramid-' + process.pid),
+	W = 512;
+
+/**
+ * Tests helper functions.
+ */
+
+function build(pyramid, src, done) {
+	fs.stat(src, function(err, stat) {
+		should.not.exist(err);
+
+		Image.decode(fs.readFileSync(src), function(err, image) {
+			should.not.exist(err);
+
+			pyramid.build(src, stat, image, function(err) {
+				should.not.exist(err);
+				done();
+			});
+		});
+	});
+}
+
+function files(dir) {
+	return fs.readdirSync(dir).reduce(function(list, name) {
+		var filename = path.join(dir, name);
+		return list.concat(fs.statSync(filename).isDirectory() ? files(filename) : [filename]);
+	}, []);
+}
+
+function rmdir(dir) {
+	if (!fs.existsSync(dir)) return;
+
+	fs.readdirSync(dir).forEach(function(name) {
+		var filename = path.join(dir, name);
+		if (fs.statSync(filename).isDirectory()) rmdir(filename);
+		else fs.unlinkSync(filename);
+	});
+	fs.rmdirSync(dir);
+}
+
+/**
+ * Test suite.
+ */
+
+describe('Pyramid', function() {
+	beforeEach(function() {
+		this.pyramid = new Pyramid(PYRAMID_DIR);
+	});
+
+	before(function() {
+		try { fs.mkdirSync(path.dirname(PYRAMID_DIR)); }
+		catch(err) { /* let cry */ }
+	});
+
+	after(function() {
+		rmdir(PYRAMID_DIR);
+		rmdir(PYRAMID_DIR + '-cold');
+	});
+
+	describe('#open', function() {
+		it('should give a null header when not built', function(done) {
+			new Pyramid(PYRAMID_DIR + '-empty').open(SRC_IMAGE, function(err, header, stat) {
+				should.not.exist(err);
+				should.not.exist(header);
+				stat.should.have.property('size');
+				done();
+			});
+		});
+
+		it('should give an error when the source does not exist', function(done) {
+			this.pyramid.open('NaNaNaN.jpg', function(err) {
+				err.should.be.instanceof(Error);
+				done();
+			});
+		});
+	});
+
+	describe('#build', function() {
+		it('should halve the source until the minimum size', function(done) {
+			var pyramid = this.pyramid;
+
+			build(pyramid, SRC_IMAGE, function() {
+				pyramid.open(SRC_IMAGE, function(err, header) {
+					should.not.exist(err);
+					header.should.have.property('width', W);
+					header.should.have.property('height', W);
+					header.levels.map(function(level) { return level.width; }).should.eql([W / 2, W / 4, W / 8]);
+					pyramid.close(header);
+					done();
+				});
+			});
+		});
+
+		it('should leave the decoded image untouched', function(done) {
+			var pyramid = this.pyramid;
+
+			fs.stat(SRC_IMAGE, function(err, stat) {
+				Image.decode(fs.readFileSync(SRC_IMAGE), function(err, image) {
+					pyramid.build(SRC_IMAGE, stat, image, function(err) {
+						should.not.exist(err);
+						image.should.have.property('width', W);
+						image.should.have.lengthOf(W * W * 3);
+						done();
+					});
+				});
+			});
+		});
+
+		it('should build levels from the pixels as they were', function(done) {
+			var pyramid = this.pyramid;
+
+			fs.stat(SRC_IMAGE, function(err, stat) {
+				Image.decode(fs.readFileSync(SRC_IMAGE), function(err, image) {
+					pyramid.build(SRC_IMAGE, stat, image, function(err) {
+						should.not.exist(err);
+
+						pyramid.open(SRC_IMAGE, function(err, header) {
+							pyramid.read(header, header.levels[0], function(err, buffer) {
+								pyramid.close(header);
+
+								Image.decode(buffer, function(err, level) {
+									should.not.exist(err);
+									var lit = Array.prototype.some.call(level, function(value) { return value > 0; });
+									lit.should.be.true;
+									done();
+								});
+							});
+						});
+					});
+
+					// blacken pixels in place while levels are being built
+					image.mapPixel(function(pixel) { pixel.r = pixel.g = pixel.b = 0; });
+				});
+			});
+		});
+
+		it('should remove the pyramid of a previous version of the source', function(done) {
+			var pyramid = this.pyramid,
+				src = path.join(SRC_DIR, 'tmp', 'lena-' + process.pid + '.bmp');
+
+			fs.writeFileSync(src, fs.readFileSync(SRC_IMAGE));
+			build(pyramid, src, function() {
+				var previous = pyramid.filename(src, fs.statSync(src));
+
+				// new version of the source
+				fs.utimesSync(src, new Date(), new Date(Date.now() + 10000));
+
+				build(pyramid, src, function() {
+					var current = pyramid.filename(src, fs.statSync(src));
+
+					fs.unlinkSync(src);
+					current.should.not.equal(previous);
+					fs.existsSync(current).should.be.true;
+					fs.existsSync(previous).should.be.false;
+					done();
+				});
+			});
+		});
+
+		it('should not build anything for small sources', function(done) {
+			var pyramid = this.pyramid;
+
+			build(pyramid, SMALL_IMAGE, function() {
+				pyramid.open(SMALL_IMAGE, function(err, header) {
+					should.not.exist(err);
+					should.not.exist(header);
+					done();
+				});
+			});
+		});
+	});
+
+	describe('#read', function() {
+		it('should give a decodable level', function(done) {
+			var pyramid = this.pyramid;
+
+			build(pyramid, SRC_IMAGE, function() {
+				pyramid.open(SRC_IMAGE, function(err, header) {
+					pyramid.read(header, header.levels[1], function(err, buffer) {
+						pyramid.close(header);
+						should.not.exist(err);
+
+						Image.decode(buffer, function(err, image) {
+							should.not.exist(err);
+							image.should.have.property('width', W / 4);
+							image.should.have.property('height', W / 4);
+							done();
+						});
+					});
+				});
+			});
+		});
+	});
+
+	describe('.select', function() {
+		var header = { levels: [{ width: 256, height: 128 }, { width: 128, height: 64 }, { width: 64, height: 32 }] };
+
+		it('should select the smallest level larger than the target', function() {
+			Pyramid.select(header, 100, 50).should.equal(header.levels[1]);
+			Pyramid.select(header, 128, 64).should.equal(header.levels[1]);
+			Pyramid.select(header, 10, 10).should.equal(header.levels[2]);
+		});
+
+		it('should select nothing when the target is larger than every level', function() {
+			should.not.exist(Pyramid.select(header, 300, 10));
+			should.not.exist(Pyramid.select(header, 10, 200));
+		});
+	});
+
+	describe('from', function() {
+		it('should resize from the nearest level', function(done) {
+			var pyramid = this.pyramid;
+
+			build(pyramid, SRC_IMAGE, function() {
+				var spy = sinon.spy(Image, 'decode');
+
+				new Pipeline()
+					.from({ src: SRC_IMAGE, pyramid: pyramid })
+					.resize({ width: 'x25', height: 'x25' })
+					.done(function(err, image) {
+						var decoded = spy.firstCall.args[0];
+						spy.restore();
+
+						should.not.exist(err);
+						image.should.have.property('width', W / 4);
+						image.should.have.property('height', W / 4);
+						decoded.length.should.be.below(fs.statSync(SRC_IMAGE).size / 4);
+						done();
+					});
+			});
+		});
+
+		it('should decode the source once and build the pyramid from it the first time', function(done) {
+			var pyramid = new Pyramid(PYRAMID_DIR + '-cold'),
+				build = pyramid.build,
+				spy = sinon.spy(Image, 'decode'),
+				built, resized;
+
+			var end = function() {
+				if (!built || !resized) return;
+				spy.restore();
+				spy.should.have.been.calledOnce;
+				built.should.equal(resized);
+				files(PYRAMID_DIR + '-cold').should.have.lengthOf(1);
+				done();
+			};
+
+			pyramid.build = function(src, stat, image) {
+				build.call(pyramid, src, stat, image, function(err) {
+					should.not.exist(err);
+					built = image;
+					end();
+				});
+			};
+
+			new Pipeline()
+				.from({ src: SRC_IMAGE, pyramid: pyramid })
+				.resize({ width: 'x25', height: 'x25' })
+				.done(function(err, image) {
+					should.not.exist(err);
+					image.should.have.property('width', W / 4);
+					resized = image;
+					end();
+				});
+		});
+
+		it('should decode the source when there is no resize', function(done) {
+			var pyramid = this.pyramid;
+
+			build(pyramid, SRC_IMAGE, function() {
+				new Pipeline()
+					.from({ src: SRC_IMAGE, pyramid: pyramid })
+					.done(function(err, image) {
+						should.not.exist(err);
+						image.should.have.property('width', W);
+						done();
+					});
+			});
+		});
+	});
+});
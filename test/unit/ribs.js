@@ -22,6 +22,7 @@ var ribs = require('../..'),
 
 var SRC_DIR = require('ribs-fixtures').path,
 	SRC_IMAGE = path.join(SRC_DIR, '0124.png'),
+	LARGE_IMAGE = path.join(SRC_DIR, 'lena.bmp'),
 	TMP_DIR = path.resolve(SRC_DIR, 'tmp'),
 	TMP_FILE = path.join(TMP_DIR, '0124-ribs.png'),
 	W = 8,
@@ -191,4 +192,140 @@ describe('ribs', function() {
 			});
 		});
 	});
-});
\ No newline at end of file
+
+	describe('#inlineThreshold', function() {
+		var threshold;
+
+		before(function() {
+			threshold = ribs.inlineThreshold;
+		});
+
+		after(function() {
+			ribs.inlineThreshold = threshold;
+		});
+
+		it('should default to a 100x100 RGB image', function() {
+			threshold.should.equal(100 * 100 * 3);
+		});
+
+		it('should process tiny images inline', function(done) {
+			var stats = ribs.stats();
+
+			ribs.inlineThreshold = 1024 * 1024;
+			ribs.from(SRC_IMAGE).resize(W / 2).done(function(err) {
+				should.not.exist(err);
+				ribs.stats().inline.should.equal(stats.inline + 2);
+				ribs.stats().queued.should.equal(stats.queued);
+				done();
+			});
+		});
+
+		it('should process images in the thread pool when disabled', function(done) {
+			var stats = ribs.stats();
+
+			ribs.inlineThreshold = 0;
+			ribs.from(SRC_IMAGE).resize(W / 2).done(function(err) {
+				should.not.exist(err);
+				ribs.stats().inline.should.equal(stats.inline);
+				ribs.stats().queued.should.equal(stats.queued + 2);
+				done();
+			});
+		});
+
+		it('should never process forged huge images inline', function(done) {
+			var buffer = fs.readFileSync(SRC_IMAGE),
+				stats = ribs.stats();
+
+			// 65536x65536 in the PNG header, the pixel count wraps around 32 bits
+			buffer.writeUInt32BE(65536, 16);
+			buffer.writeUInt32BE(65536, 20);
+
+			ribs.inlineThreshold = 0xffffffff;
+			Image.decode(buffer, function() {
+				ribs.stats().inline.should.equal(stats.inline);
+				ribs.stats().queued.should.equal(stats.queued + 1);
+				done();
+			});
+		});
+
+		it('should still invoke callbacks asynchronously', function(done) {
+			var sync = true;
+
+			ribs.inlineThreshold = 1024 * 1024;
+			fs.readFile(SRC_IMAGE, function(err, buffer) {
+				Image.decode(buffer, function(err, image) {
+					should.not.exist(err);
+					image.should.be.instanceof(Image);
+					sync.should.be.false;
+					done();
+				});
+				sync = false;
+			});
+		});
+	});
+
+	describe('#cancel', function() {
+		var threshold;
+
+		before(function() {
+			threshold = ribs.inlineThreshold;
+			ribs.inlineThreshold = 0;
+		});
+
+		after(function() {
+			ribs.inlineThreshold = threshold;
+		});
+
+		it('should cancel queued operations', function(done) {
+			var buffer = fs.readFileSync(SRC_IMAGE),
+				count = 16,
+				ids = [];
+
+			var callback = function(err, image) {
+				if (err) err.message.should.equal('operation cancelled');
+				else image.should.be.instanceof(Image);
+
+				if (0 !== --count) return;
+
+				// already over
+				ids.forEach(function(id) {
+					ribs.cancel(id).should.be.false;
+				});
+				done();
+			};
+
+			for (var i = 0; i < count; i++)
+				ids.push(Image.decode(buffer, callback));
+
+			ids.forEach(function(id) {
+				id.should.be.a('number');
+				ribs.cancel(id).should.be.true;
+			});
+		});
+
+		it('should cancel a running png encoding', function(done) {
+			Image.decode(fs.readFileSync(LARGE_IMAGE), function(err, image) {
+				should.not.exist(err);
+
+				image.resize(4096, 4096, function(err, image) {
+					should.not.exist(err);
+
+					var id = image.encode('png', 0, {}, function(err, data) {
+						err.message.should.equal('operation cancelled');
+						should.not.exist(data);
+						done();
+					});
+
+					// let a thread pick it up
+					setImmediate(function() {
+						ribs.cancel(id).should.be.true;
+					});
+				});
+			});
+		});
+
+		it('should not cancel unknown operations', function() {
+			ribs.cancel(0).should.be.false;
+		});
+	});
+});
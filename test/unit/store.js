@@ -0,0 +1,304 @@
+/*!
+ * ribs
+ * Copyright (c) 2013-2014 Nicolas Gryman <ngryman@gmail.com>
+ * LGPL Licensed
+ */
+
+'use strict';
+
+/**
+ * Module dependencies.
+ */
+
+var ribs = require('../..'),
+	Store = ribs.Store,
+	fs = require('fs'),
+	net = require('net'),
+	path = require('path');
+
+/**
+ * Tests constants.
+ */
+
+var SRC_DIR = require('ribs-fixtures').path,
+	STORE_DIR = path.join(SRC_DIR, 'tmp/store-' + process.pid),
+	SEGMENT_SIZE = 4000;
+
+/**
+ * Tests helper functions.
+ */
+
+var dirs = 0;
+
+function create(options) {
+	return new Store(STORE_DIR + '-' + (dirs++), options || { segmentSize: SEGMENT_SIZE });
+}
+
+function reopen(store, callback) {
+	store.close(function(err) {
+		should.not.exist(err);
+		callback(new Store(store.dir, { segmentSize: store.segmentSize, maxSize: store.maxSize }));
+	});
+}
+
+function data(length, value) {
+	var buffer = new Buffer(length);
+	buffer.fill(value);
+	return buffer;
+}
+
+function fill(store, count, length, callback) {
+	var i = 0;
+
+	(function next() {
+		if (i == count) return callback();
+
+		store.set('key' + i, data(length, i), function(err) {
+			should.not.exist(err);
+			i++;
+			next();
+		});
+	})();
+}
+
+function segments(store) {
+	return fs.readdirSync(store.dir).filter(function(name) { return /\.seg$/.test(name); }).sort();
+}
+
+function rmdir(dir) {
+	fs.readdirSync(dir).forEach(function(name) {
+		fs.unlinkSync(path.join(dir, name));
+	});
+	fs.rmdirSync(dir);
+}
+
+/**
+ * Test suite.
+ */
+
+describe('Store', function() {
+	after(function() {
+		for (var i = 0; i < dirs; i++) {
+			if (fs.existsSync(STORE_DIR + '-' + i))
+				rmdir(STORE_DIR + '-' + i);
+		}
+	});
+
+	describe('#get', function() {
+		it('should give an entry once set', function(done) {
+			var store = create();
+
+			store.set('/r/100/lena.bmp', data(100, 42), function(err) {
+				should.not.exist(err);
+
+				store.get('/r/100/lena.bmp', function(err, buffer) {
+					should.not.exist(err);
+					buffer.should.have.lengthOf(100);
+					buffer[99].should.equal(42);
+					store.close(done);
+				});
+			});
+		});
+
+		it('should give null for an unknown entry', function(done) {
+			var store = create();
+
+			store.get('NaNaNaN', function(err, buffer) {
+				should.not.exist(err);
+				should.not.exist(buffer);
+				store.close(done);
+			});
+		});
+
+		it('should give the last version of an entry', function(done) {
+			var store = create();
+
+			store.set('key', data(10, 1));
+			store.set('key', data(20, 2), function() {
+				store.get('key', function(err, buffer) {
+					buffer.should.have.lengthOf(20);
+					buffer[0].should.equal(2);
+					store.close(done);
+				});
+			});
+		});
+
+		it('should give an error once closed', function(done) {
+			var store = create();
+
+			store.set('key', data(10, 1));
+			store.close(function() {
+				store.get('key', function(err, buffer) {
+					err.message.should.equal('store closed');
+					should.not.exist(buffer);
+					done();
+				});
+			});
+		});
+	});
+
+	describe('#send', function() {
+		it('should write a header then an entry to a socket', function(done) {
+			var store = create(),
+				chunks = [];
+
+			var server = net.createServer(function(socket) {
+				store.send('key', socket, function(length) {
+					length.should.equal(1000);
+					return new Buffer('head');
+				}, function(err, found) {
+					should.not.exist(err);
+					found.should.be.true;
+					socket.end();
+				});
+			});
+
+			server.listen(0, function() {
+				store.set('key', data(1000, 7), function() {
+					net.connect(server.address().port)
+						.on('data', function(chunk) { chunks.push(chunk); })
+						.on('end', function() {
+							var received = Buffer.concat(chunks);
+							received.should.have.lengthOf(1004);
+							received.toString('utf8', 0, 4).should.equal('head');
+							received[1003].should.equal(7);
+							server.close();
+							store.close(done);
+						});
+				});
+			});
+		});
+
+		it('should tell an unknown entry is not found', function(done) {
+			var store = create();
+
+			store.send('NaNaNaN', null, null, function(err, found) {
+				should.not.exist(err);
+				found.should.be.false;
+				store.close(done);
+			});
+		});
+	});
+
+	describe('recovery', function() {
+		it('should reload entries', function(done) {
+			var store = create();
+
+			fill(store, 20, 500, function() {
+				reopen(store, function(store) {
+					Object.keys(store.entries).should.have.lengthOf(20);
+
+					store.get('key19', function(err, buffer) {
+						should.not.exist(err);
+						buffer[0].should.equal(19);
+						store.close(done);
+					});
+				});
+			});
+		});
+
+		it('should drop a torn record', function(done) {
+			var store = create();
+
+			fill(store, 3, 500, function() {
+				store.close(function() {
+					var filename = path.join(store.dir, segments(store).pop()),
+						size = fs.statSync(filename).size;
+
+					// record header announcing more data than there is
+					fs.appendFileSync(filename, new Buffer([0, 0, 0, 1, 0, 0, 0, 3, 0, 0, 1, 0, 65, 66, 67, 1]));
+
+					store = new Store(store.dir, { segmentSize: SEGMENT_SIZE });
+					fs.statSync(filename).size.should.equal(size);
+					Object.keys(store.entries).should.have.lengthOf(3);
+					store.close(done);
+				});
+			});
+		});
+
+		it('should drop a corrupted record', function(done) {
+			var store = create();
+
+			store.set('key', data(100, 1));
+			store.set('key', data(100, 2), function() {
+				store.close(function() {
+					var filename = path.join(store.dir, segments(store).pop()),
+						fd = fs.openSync(filename, 'r+');
+
+					fs.writeSync(fd, new Buffer([3]), 0, 1, fs.statSync(filename).size - 1);
+					fs.closeSync(fd);
+
+					store = new Store(store.dir, { segmentSize: SEGMENT_SIZE });
+					store.get('key', function(err, buffer) {
+						buffer[0].should.equal(1);
+						store.close(done);
+					});
+				});
+			});
+		});
+	});
+
+	describe('maintenance', function() {
+		it('should evict the oldest entries past the maximum size', function(done) {
+			var store = create({ segmentSize: SEGMENT_SIZE, maxSize: 3 * SEGMENT_SIZE });
+
+			fill(store, 40, 500, function() {
+				store.flush(function() {
+					store.size.should.be.at.most(4 * SEGMENT_SIZE);
+					store.has('key0').should.be.false;
+					store.has('key39').should.be.true;
+					store.close(done);
+				});
+			});
+		});
+
+		it('should evict before the active segment is full', function(done) {
+			var store = create({ maxSize: 8000 });
+
+			fill(store, 40, 500, function() {
+				store.flush(function() {
+					store.size.should.be.at.most(8000);
+					store.has('key39').should.be.true;
+					store.close(done);
+				});
+			});
+		});
+
+		it('should keep entries read since they were written', function(done) {
+			var store = create({ segmentSize: SEGMENT_SIZE, maxSize: 3 * SEGMENT_SIZE });
+
+			store.set('hot', data(500, 1), function() {
+				store.get('hot', function() {
+					fill(store, 40, 500, function() {
+						store.flush(function() {
+							store.has('hot').should.be.true;
+							store.close(done);
+						});
+					});
+				});
+			});
+		});
+
+		it('should compact overwritten entries', function(done) {
+			var store = create();
+			var i = 0;
+
+			(function next() {
+				if (60 == i) {
+					return store.flush(function() {
+						segments(store).should.have.lengthOf(1);
+						store.get('key2', function(err, buffer) {
+							buffer[0].should.equal(59);
+							store.close(done);
+						});
+					});
+				}
+
+				store.set('key' + (i % 3), data(500, i), function() {
+					i++;
+					next();
+				});
+			})();
+		});
+	});
+});
@@ -72,6 +72,20 @@ var testAnchor = curry(function(anchor, width, height, expectedX, expectedY, don
 	done();
 });
 
+var testSharpen = curry(function(spec, expected, done) {
+	try {
+		var res = utils.parseSharpen(spec);
+	}
+	catch (err) {
+		err.message.should.equal(expected);
+		return done();
+	}
+
+	res.should.eql(expected);
+
+	done();
+});
+
 /**
  * Test suite.
  */
@@ -113,6 +127,25 @@ describe('utils', function() {
 		it('should throw an error when passing an invalid value', testFormula('woot', 'invalid formula: woot'));
 	});
 
+	describe('parse sharpen', function() {
+		it('should parse an amount', testSharpen('s80', { amount: 80, radius: 1, threshold: 0 }));
+
+		it('should parse a negative amount', testSharpen('s-50', { amount: -50, radius: 1, threshold: 0 }));
+
+		it('should parse an amount and a radius', testSharpen('s80_1.5', { amount: 80, radius: 1.5, threshold: 0 }));
+
+		it('should parse an amount, a radius and a threshold', testSharpen('s80_2_3', {
+			amount: 80, radius: 2, threshold: 3
+		}));
+
+		it('should accept an object', testSharpen({ amount: 80 }, { amount: 80, radius: 1, threshold: 0 }));
+
+		it('should throw an error when passing an invalid value', testSharpen('s80_x', 'invalid sharpen: s80_x'));
+
+		it('should throw an error when passing a null radius', testSharpen({ amount: 80, radius: 0 },
+			'invalid sharpen: {"amount":80,"radius":0}'));
+	});
+
 	describe('compute region origin', function() {
 		it('should return top left origin', testRegionOrigin('tl', 100, 100, 10, 10, 10, 10));
 		it('should return top left origin', testRegionOrigin('lt', 100, 100, 10, 10, 10, 10));